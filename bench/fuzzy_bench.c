@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Times fuzzy search over a large synthetic history, the way the search worker runs it: every row is matched against a
+ * term, and each key appended to a term only rescans the previous term's matches. Exits with a failure if any search
+ * takes longer than the per-keystroke budget.
+ *
+ *     clip-bench [entries]
+ */
+
+#include "fuzzy.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_DEFAULT_ENTRIES 100000
+#define BENCH_BUDGET_MS 16.0
+#define BENCH_RUNS 5
+
+static const char *words[] = {
+    "the", "clipboard", "history", "select", "from", "where", "int", "return", "static", "const", "char", "void",
+    "include", "define", "struct", "https://example.com/", "/usr/local/bin/", "git", "commit", "merge", "branch",
+    "password", "token", "ssh-rsa", "AAAAB3Nza", "function", "config", "value", "error", "warning", "debug", "trace",
+    "meeting", "tomorrow", "at", "and", "or", "not", "to", "of", "in", "is", "for", "on", "with", "as", "by", "this",
+    "0x7fff5fbff8c8", "2016-10-19", "12:34:56", "localhost:8080", "README.md", "Makefile", "src/main.c", "TODO:",
+};
+
+typedef struct {
+    char *arena;
+    gsize *offsets;
+    guint length;
+} Rows;
+
+static guint64 bench_state = 0x9e3779b97f4a7c15ULL;
+
+static guint64 bench_random(void)
+{
+    bench_state ^= bench_state << 13;
+    bench_state ^= bench_state >> 7;
+    bench_state ^= bench_state << 17;
+    return bench_state;
+}
+
+/**
+ * Builds rows of words, averaging about 190 bytes, into one arena as the history snapshot does.
+ */
+static void bench_rows_new(Rows *rows, guint length)
+{
+    gsize capacity = (gsize)length * 256;
+    gsize size = 0;
+    rows->arena = g_malloc(capacity);
+    rows->offsets = g_malloc((length + 1) * sizeof(gsize));
+    rows->length = length;
+
+    guint count = sizeof(words) / sizeof(words[0]);
+    for(guint i = 0; i < length; i++){
+        rows->offsets[i] = size;
+        gsize target = 120 + bench_random() % 140;
+        gsize row_size = 0;
+        while(row_size < target){
+            const char *word = words[bench_random() % count];
+            gsize word_length = strlen(word);
+            if(row_size + word_length + 1 > 250){
+                break;
+            }
+            memcpy(rows->arena + size + row_size, word, word_length);
+            row_size += word_length;
+            rows->arena[size + row_size++] = ' ';
+        }
+        rows->arena[size + row_size] = '\0';
+        size += row_size + 1;
+    }
+    rows->offsets[length] = size;
+}
+
+static void bench_rows_free(Rows *rows)
+{
+    g_free(rows->arena);
+    g_free(rows->offsets);
+}
+
+/**
+ * Matches the term against the candidate rows, or every row if candidates is NULL. Matching rows are written to matches,
+ * which is returned with its length set in found. Returns the time taken in milliseconds.
+ */
+static double bench_search(Rows *rows, const char *term, const guint *candidates, guint candidate_count, guint *matches,
+        guint *found)
+{
+    gint64 start = g_get_monotonic_time();
+    ClipFuzzyPattern *pattern = clip_fuzzy_pattern_new(term);
+    guint length = candidates == NULL ? rows->length : candidate_count;
+    guint count = 0;
+    for(guint i = 0; i < length; i++){
+        guint row = candidates == NULL ? i : candidates[i];
+        gint score = 0;
+        const char *text = rows->arena + rows->offsets[row];
+        if(clip_fuzzy_match(pattern, text, rows->offsets[row + 1] - rows->offsets[row] - 1, &score)){
+            matches[count++] = row;
+        }
+    }
+    clip_fuzzy_pattern_free(pattern);
+    *found = count;
+    return (g_get_monotonic_time() - start) / 1000.0;
+}
+
+static int bench_compare(const void *a, const void *b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Runs the same search a few times, since a single run is easily thrown off by the rest of the system. Returns the
+ * median time, and the slowest in max.
+ */
+static double bench_median(Rows *rows, const char *term, const guint *candidates, guint candidate_count,
+        guint *matches, guint *found, double *max)
+{
+    double times[BENCH_RUNS];
+    for(int i = 0; i < BENCH_RUNS; i++){
+        times[i] = bench_search(rows, term, candidates, candidate_count, matches, found);
+    }
+    qsort(times, BENCH_RUNS, sizeof(double), bench_compare);
+    *max = times[BENCH_RUNS - 1];
+    return times[BENCH_RUNS / 2];
+}
+
+/**
+ * Runs a search from scratch, as when a term is pasted or the fuzzy leader is pressed with a term.
+ */
+static double bench_cold(Rows *rows, const char *term, guint *matches)
+{
+    guint found = 0;
+    double max = 0;
+    double median = bench_median(rows, term, NULL, 0, matches, &found, &max);
+    g_print("cold   %-20s %7u matches  median %6.2f ms  max %6.2f ms\n", term, found, median, max);
+    return median;
+}
+
+/**
+ * Types the term one key at a time. Each key after the first only rescans the previous key's matches. Returns the
+ * median time of the slowest key.
+ */
+static double bench_typed(Rows *rows, const char *term, guint *matches, guint *previous)
+{
+    double slowest = 0;
+    guint found = 0;
+    gsize length = strlen(term);
+    char *prefix = g_malloc(length + 1);
+    for(gsize i = 1; i <= length; i++){
+        memcpy(prefix, term, i);
+        prefix[i] = '\0';
+        memcpy(previous, matches, found * sizeof(guint));
+        double max = 0;
+        double time = bench_median(rows, prefix, i == 1 ? NULL : previous, found, matches, &found, &max);
+        slowest = MAX(slowest, time);
+    }
+    g_print("typed  %-20s %7u matches  slowest key median %6.2f ms\n", term, found, slowest);
+    g_free(prefix);
+    return slowest;
+}
+
+int main(int argc, char **argv)
+{
+    static const char *terms[] = { "d", "dkrrm", "config", "clipboard history", "srcmain", "zzzzzq" };
+
+    guint length = argc > 1 ? (guint)strtoul(argv[1], NULL, 10) : BENCH_DEFAULT_ENTRIES;
+    Rows rows;
+    bench_rows_new(&rows, length);
+    guint *matches = g_malloc(length * sizeof(guint));
+    guint *previous = g_malloc(length * sizeof(guint));
+    g_print("%u entries, %.1f MB of text\n", length, rows.offsets[length] / 1048576.0);
+
+    double slowest = 0;
+    for(gsize i = 0; i < sizeof(terms) / sizeof(terms[0]); i++){
+        double time = bench_cold(&rows, terms[i], matches);
+        slowest = MAX(slowest, time);
+    }
+    for(gsize i = 0; i < sizeof(terms) / sizeof(terms[0]); i++){
+        double time = bench_typed(&rows, terms[i], matches, previous);
+        slowest = MAX(slowest, time);
+    }
+
+    g_print("slowest search %.2f ms, budget %.0f ms: %s\n", slowest, BENCH_BUDGET_MS,
+            slowest <= BENCH_BUDGET_MS ? "ok" : "over budget");
+    g_free(matches);
+    g_free(previous);
+    bench_rows_free(&rows);
+    return slowest <= BENCH_BUDGET_MS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ascii.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__SSE2__) && defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define ASCII_AVX2 1
+#endif
+
+typedef gsize (*AsciiSpanFunc)(const char *text, gsize length);
+typedef void (*AsciiMapFunc)(char *dest, const char *src, gsize length, gboolean upper);
+
+// Chosen once, on first use, by the CPU's features.
+static AsciiSpanFunc span_ascii = NULL;
+static AsciiMapFunc map_case = NULL;
+
+
+static gboolean clip_ascii_is_space(char c)
+{
+    return c == ' ' || (guchar)(c - '\t') <= '\r' - '\t';
+}
+
+static gsize clip_ascii_span_scalar(const char *text, gsize length)
+{
+    gsize i = 0;
+    while(i < length && (guchar)text[i] < 0x80){
+        i++;
+    }
+    return i;
+}
+
+static void clip_ascii_map_case_scalar(char *dest, const char *src, gsize length, gboolean upper)
+{
+    char first = upper ? 'a' : 'A';
+    for(gsize i = 0; i < length; i++){
+        char c = src[i];
+        dest[i] = (guchar)(c - first) <= 'z' - 'a' ? c ^ 0x20 : c;
+    }
+}
+
+#ifdef __SSE2__
+/**
+ * Returns a mask of the whitespace bytes in the chunk. \t to \r are contiguous, so they're one unsigned range test.
+ */
+static int clip_ascii_space_mask_sse2(__m128i chunk)
+{
+    __m128i offset = _mm_sub_epi8(chunk, _mm_set1_epi8('\t'));
+    __m128i in_range = _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8('\r' - '\t')), offset);
+    __m128i space = _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' '));
+    return _mm_movemask_epi8(_mm_or_si128(in_range, space));
+}
+
+static gsize clip_ascii_span_sse2(const char *text, gsize length)
+{
+    gsize i = 0;
+    for(; i + 16 <= length; i += 16){
+        int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(text + i)));
+        if(mask != 0){
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + clip_ascii_span_scalar(text + i, length - i);
+}
+
+static void clip_ascii_map_case_sse2(char *dest, const char *src, gsize length, gboolean upper)
+{
+    __m128i first = _mm_set1_epi8(upper ? 'a' : 'A');
+    __m128i last = _mm_set1_epi8('z' - 'a');
+    __m128i flip = _mm_set1_epi8(0x20);
+    gsize i = 0;
+    for(; i + 16 <= length; i += 16){
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i offset = _mm_sub_epi8(chunk, first);
+        __m128i letters = _mm_cmpeq_epi8(_mm_min_epu8(offset, last), offset);
+        _mm_storeu_si128((__m128i*)(dest + i), _mm_xor_si128(chunk, _mm_and_si128(letters, flip)));
+    }
+    clip_ascii_map_case_scalar(dest + i, src + i, length - i, upper);
+}
+#endif
+
+#ifdef ASCII_AVX2
+__attribute__((target("avx2")))
+static gsize clip_ascii_span_avx2(const char *text, gsize length)
+{
+    gsize i = 0;
+    for(; i + 32 <= length; i += 32){
+        guint32 mask = _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(text + i)));
+        if(mask != 0){
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + clip_ascii_span_scalar(text + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static void clip_ascii_map_case_avx2(char *dest, const char *src, gsize length, gboolean upper)
+{
+    __m256i first = _mm256_set1_epi8(upper ? 'a' : 'A');
+    __m256i last = _mm256_set1_epi8('z' - 'a');
+    __m256i flip = _mm256_set1_epi8(0x20);
+    gsize i = 0;
+    for(; i + 32 <= length; i += 32){
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i offset = _mm256_sub_epi8(chunk, first);
+        __m256i letters = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, last), offset);
+        _mm256_storeu_si256((__m256i*)(dest + i), _mm256_xor_si256(chunk, _mm256_and_si256(letters, flip)));
+    }
+    clip_ascii_map_case_scalar(dest + i, src + i, length - i, upper);
+}
+#endif
+
+static void clip_ascii_init(void)
+{
+    static gsize initialized = 0;
+    if(!g_once_init_enter(&initialized)){
+        return;
+    }
+#if defined(ASCII_AVX2)
+    if(__builtin_cpu_supports("avx2")){
+        span_ascii = clip_ascii_span_avx2;
+        map_case = clip_ascii_map_case_avx2;
+    } else {
+        span_ascii = clip_ascii_span_sse2;
+        map_case = clip_ascii_map_case_sse2;
+    }
+#elif defined(__SSE2__)
+    span_ascii = clip_ascii_span_sse2;
+    map_case = clip_ascii_map_case_sse2;
+#else
+    span_ascii = clip_ascii_span_scalar;
+    map_case = clip_ascii_map_case_scalar;
+#endif
+    g_once_init_leave(&initialized, 1);
+}
+
+
+/*
+ * Whitespace runs are usually short, so the spans only use SSE2: a wider chunk would rarely be filled.
+ */
+gsize clip_ascii_span_space(const char *text, gsize length)
+{
+    gsize i = 0;
+#ifdef __SSE2__
+    for(; i + 16 <= length; i += 16){
+        int mask = clip_ascii_space_mask_sse2(_mm_loadu_si128((const __m128i*)(text + i)));
+        if(mask != 0xffff){
+            return i + __builtin_ctz(~mask);
+        }
+    }
+#endif
+    while(i < length && clip_ascii_is_space(text[i])){
+        i++;
+    }
+    return i;
+}
+
+gsize clip_ascii_span_space_reverse(const char *text, gsize length)
+{
+    gsize i = 0;
+#ifdef __SSE2__
+    for(; i + 16 <= length; i += 16){
+        int mask = clip_ascii_space_mask_sse2(_mm_loadu_si128((const __m128i*)(text + length - i - 16)));
+        if(mask != 0xffff){
+            // The last byte is the chunk's highest bit.
+            return i + __builtin_clz((guint32)~mask << 16);
+        }
+    }
+#endif
+    while(i < length && clip_ascii_is_space(text[length - i - 1])){
+        i++;
+    }
+    return i;
+}
+
+gsize clip_ascii_span(const char *text, gsize length)
+{
+    clip_ascii_init();
+    return span_ascii(text, length);
+}
+
+void clip_ascii_map_case(char *dest, const char *src, gsize length, gboolean upper)
+{
+    clip_ascii_init();
+    map_case(dest, src, length, upper);
+}
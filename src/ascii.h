@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+
+/**
+ * Byte kernels for scanning and case-mapping large texts. Each runs 16 bytes at a time with SSE2, or 32 with AVX2 when
+ * the CPU has it, and falls back to a byte loop elsewhere. They're safe to call from any thread.
+ */
+
+/**
+ * Returns the number of whitespace bytes, as g_ascii_isspace defines it, at the start of the text.
+ */
+gsize clip_ascii_span_space(const char *text, gsize length);
+/**
+ * Returns the number of whitespace bytes at the end of the text.
+ */
+gsize clip_ascii_span_space_reverse(const char *text, gsize length);
+/**
+ * Returns the number of ASCII bytes at the start of the text. The text is all ASCII if this is its length.
+ */
+gsize clip_ascii_span(const char *text, gsize length);
+/**
+ * Maps ASCII letters to upper or lower case, copying the text from src to dest. Other bytes are copied unchanged, so
+ * this is only a full case mapping for ASCII text. dest may be src, to map in place.
+ */
+void clip_ascii_map_case(char *dest, const char *src, gsize length, gboolean upper);
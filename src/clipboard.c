@@ -21,7 +21,9 @@
 
 #include "clipboard.h"
 #include "clipboard_events.h"
+#include "filter.h"
 #include "history.h"
+#include "transform.h"
 #include "utils.h"
 
 #include <glib.h>
@@ -32,11 +34,29 @@ struct clipboard {
     ClipboardProvider *provider;
     ClipboardHistory *history;
     ClipboardEntry *current;
-    char *current_text;
+    ClipboardText *current_text;
     TrimMode trim_mode;
     gboolean enabled;
+    // Running transforms by entry id.
+    GHashTable *transforms;
+    ClipFilter *filter;
 };
 
+/**
+ * A transform running on a worker. The texts it started from are kept, so a result computed from text that has since
+ * changed is dropped rather than overwriting the change.
+ */
+typedef struct {
+    Clipboard *clipboard;
+    int64_t id;
+    ClipboardEntry *entry;
+    ClipboardText *text;
+    // The entry being joined onto this one, or NULL.
+    ClipboardEntry *right;
+    ClipboardText *right_text;
+    GCancellable *cancellable;
+} ClipboardTransformJob;
+
 
 
 static void clip_clipboard_on_event(ClipboardEvent event, ClipboardEntry* entry);
@@ -50,6 +70,8 @@ Clipboard* clip_clipboard_new(ClipboardProvider *provider)
     clipboard->current = NULL;
     clipboard->current_text = NULL;
     clipboard->trim_mode = DEFAULT_TRIM_MODE;
+    clipboard->transforms = g_hash_table_new(g_int64_hash, g_int64_equal);
+    clipboard->filter = clip_filter_new();
 
     clip_events_add_observer(clip_clipboard_on_event);
 
@@ -61,84 +83,109 @@ void clip_clipboard_free(Clipboard *clipboard)
     if(clipboard == NULL){
         return;
     }
+    // Running transforms finish on their own, but have nothing to apply to.
+    GHashTableIter iter;
+    ClipboardTransformJob *job = NULL;
+    g_hash_table_iter_init(&iter, clipboard->transforms);
+    while(g_hash_table_iter_next(&iter, NULL, (gpointer*)&job)){
+        g_cancellable_cancel(job->cancellable);
+        job->clipboard = NULL;
+    }
+    g_hash_table_destroy(clipboard->transforms);
+    clipboard->transforms = NULL;
+    clip_filter_free(clipboard->filter);
+    clipboard->filter = NULL;
     clip_history_free(clipboard->history);
     clipboard->history = NULL;
-    clip_clipboard_entry_free(clipboard->current);
+    clip_clipboard_entry_unref(clipboard->current);
     clipboard->current = NULL;
     clipboard->provider = NULL;
-    g_free(clipboard->current_text);
+    clip_clipboard_text_unref(clipboard->current_text);
     clipboard->current_text = NULL;
     g_free(clipboard);
 }
 
 
-static char* clip_clipboard_clean(Clipboard *clipboard, char *text)
+/**
+ * Returns a reference to the trimmed text. When nothing needs trimming, this is the same buffer.
+ */
+static ClipboardText* clip_clipboard_clean(Clipboard *clipboard, ClipboardText *text)
 {
     if(text == NULL){
         return NULL;
     }
-    char *str = g_strdup(text);
     switch(clipboard->trim_mode) {
         case TRIM_CHOMP:
-            g_strchomp(str);
-            break;
+            return clip_clipboard_text_trim(text, FALSE, TRUE);
         case TRIM_CHUG:
-            g_strchug(str);
-            break;
+            return clip_clipboard_text_trim(text, TRUE, FALSE);
         case TRIM_STRIP:
-            g_strstrip(str);
-            break;
+            return clip_clipboard_text_trim(text, TRUE, TRUE);
         case TRIM_OFF:
         case TRIM_STOP:
             break;
     }
-    return str;
+    return clip_clipboard_text_ref(text);
 }
 
 
-/**
- * Comparator for GLib collections.
- */
-static gboolean clip_clipboard_compare_entries(ClipboardEntry *a, ClipboardEntry *b)
-{
-    return !clip_clipboard_entry_equals(a, b);
-}
-
 /**
  * Identifies if the two values differ in a meaningful way, regardless of 
  * left or right padding.
  */
-static gboolean clip_clipboard_different(char *new, char *old)
+static gboolean clip_clipboard_different(ClipboardText *new, ClipboardText *old)
 {
-    char *stripped_new = g_strstrip(g_strdup(new));
-    char *stripped_old = g_strstrip(g_strdup(old));
-    gboolean different = g_strcmp0(stripped_old, stripped_new);
-    g_free(stripped_old);
-    g_free(stripped_new);
-    return different;
+    if(new == NULL || old == NULL){
+        return new != old;
+    }
+    gsize new_start, new_end, old_start, old_end;
+    clip_clipboard_text_get_trimmed_bounds(new, TRUE, TRUE, &new_start, &new_end);
+    clip_clipboard_text_get_trimmed_bounds(old, TRUE, TRUE, &old_start, &old_end);
+    if(new_end - new_start != old_end - old_start){
+        return TRUE;
+    }
+    return memcmp(clip_clipboard_text_get_str(new) + new_start, clip_clipboard_text_get_str(old) + old_start,
+            new_end - new_start) != 0;
 }
 
-void clip_clipboard_set_new(Clipboard *clipboard, char *text)
+void clip_clipboard_set_new(Clipboard *clipboard, ClipboardText *text)
 {
     ClipboardEntry *entry = clip_clipboard_entry_new(0, text, FALSE, 0, 0, FALSE);
     clip_clipboard_set(clipboard, entry, FALSE);
-    clip_clipboard_entry_free(entry);
+    clip_clipboard_entry_unref(entry);
 }
 
 
 static gboolean clip_clipboard_replace_similar(Clipboard *clipboard, ClipboardEntry *entry)
 {
+    if(!clip_clipboard_is_enabled(clipboard)){
+        return FALSE;
+    }
     ClipboardEntry *similar = clip_history_get_similar(clipboard->history, entry, SIMILARITY_REPLACEMENT_LIMIT);
     if(similar != NULL){
         debug("Replacing similar entry, %"PRIu64".\n", clip_clipboard_entry_get_id(similar));
-        char *new_text = clip_clipboard_entry_get_text(entry);
-        clip_clipboard_entry_set_text(similar, new_text);
+        // The similar entry is shared, so its old text must come back if it doesn't end up persisted.
+        ClipboardText *old_text = clip_clipboard_text_ref(clip_clipboard_entry_get_text_buffer(similar));
+        gboolean old_masked = clip_clipboard_entry_is_masked(similar);
+        clip_clipboard_entry_set_text(similar, clip_clipboard_entry_get_text_buffer(entry));
+        // A value masked by a capture rule stays masked on the entry that takes it.
+        if(clip_clipboard_entry_is_masked(entry) && !old_masked){
+            clip_clipboard_entry_set_masked(similar, TRUE);
+        }
+        clip_history_begin(clipboard->history);
         if(!clip_clipboard_entry_is_new(entry)){
             // Just in case this is an update, remove the old one.
             clip_clipboard_remove(clipboard, entry);
         }
         clip_clipboard_set(clipboard, similar, TRUE);
-        clip_clipboard_entry_free(similar);
+        if(!clip_history_end(clipboard->history, clipboard->current == similar)){
+            clip_clipboard_entry_set_text(similar, old_text);
+            if(clip_clipboard_entry_is_masked(similar) != old_masked){
+                clip_clipboard_entry_set_masked(similar, old_masked);
+            }
+        }
+        clip_clipboard_text_unref(old_text);
+        clip_clipboard_entry_unref(similar);
         return TRUE;
     }
     return FALSE;
@@ -154,24 +201,26 @@ void clip_clipboard_set(Clipboard *clipboard, ClipboardEntry *entry, gboolean fo
         return;
     }
 
-    char *new = clip_clipboard_entry_get_text(entry);
-    char *clean_new = clip_clipboard_clean(clipboard, new);
+    ClipboardText *new = clip_clipboard_entry_get_text_buffer(entry);
+    ClipboardText *clean_new = clip_clipboard_clean(clipboard, new);
 
-    char *current = clip_clipboard_entry_get_text(clipboard->current);
-    char *clean_current = clip_clipboard_clean(clipboard, current);
+    ClipboardText *current = clip_clipboard_entry_get_text_buffer(clipboard->current);
+    ClipboardText *clean_current = clip_clipboard_clean(clipboard, current);
 
-    if(clean_new != NULL && strlen(clean_new) < 1){
+    if(clean_new != NULL && clip_clipboard_text_get_length(clean_new) < 1){
         debug("String is 0 characetrs long. Dropping and reverting current head.\n");
-        if(clean_current == NULL || strlen(clean_current) < 1){
-            clip_history_remove_head(clipboard->history);
+        if(clean_current == NULL || clip_clipboard_text_get_length(clean_current) < 1){
+            clip_history_begin(clipboard->history);
+            gboolean success = clip_history_remove_head(clipboard->history);
             ClipboardEntry *head = clip_history_get_head(clipboard->history);
             if(head == NULL){
                 debug("No usable values.\n");
             } else {
                 debug("Current value not usable. Resetting to previous head.\n");
                 clip_clipboard_set(clipboard, head, TRUE);
-                clip_clipboard_entry_free(head);
+                clip_clipboard_entry_unref(head);
             }
+            clip_history_end(clipboard->history, success);
         } else {
             clip_provider_set_current(clipboard->provider, clean_current);
         }
@@ -186,95 +235,199 @@ void clip_clipboard_set(Clipboard *clipboard, ClipboardEntry *entry, gboolean fo
 
 
     ClipboardEntry *existing = clipboard->current;
-    clipboard->current = clip_clipboard_entry_clone(entry);
-    clip_clipboard_entry_free(existing);
+    clipboard->current = clip_clipboard_entry_ref(entry);
+    clip_clipboard_entry_unref(existing);
 
-    char *existing_text = clipboard->current_text;
-    clipboard->current_text = g_strdup(clean_new);
-    g_free(existing_text);
+    ClipboardText *existing_text = clipboard->current_text;
+    clipboard->current_text = clip_clipboard_text_ref(clean_new);
+    clip_clipboard_text_unref(existing_text);
 
     if(clip_clipboard_is_enabled(clipboard)){
         if(new == NULL){
             debug("New clipboard contents are null (probably a request to clear the clipboard). Removing head.\n");
             clip_history_remove_head(clipboard->history);
         } else {
-            debug("Setting new active clipboard value, \"%.*s...\".\n", 30, new);
-            clip_history_prepend(clipboard->history, clipboard->current);
+            debug("Setting new active clipboard value, \"%.*s...\".\n", 30, clip_clipboard_text_get_str(new));
+            // Keep the history's live entry so that later changes to it are reflected here.
+            ClipboardEntry *canonical = clip_history_prepend(clipboard->history, clipboard->current);
+            if(canonical != NULL){
+                ClipboardEntry *previous = clipboard->current;
+                clipboard->current = canonical;
+                clip_clipboard_entry_unref(previous);
+            }
         }
     }
 exit:
-    g_free(clean_current);
-    g_free(clean_new);
+    clip_clipboard_text_unref(clean_current);
+    clip_clipboard_text_unref(clean_new);
 }
 
 
 
-gboolean clip_clipboard_join(Clipboard *clipboard, ClipboardEntry *left)
+gboolean clip_clipboard_replace_text(Clipboard *clipboard, ClipboardEntry *entry, ClipboardText *text)
 {
-    gboolean changed = FALSE;
-    GList *list = clip_history_get_list(clipboard->history);
-    GList *first = g_list_find_custom(list, left, (GCompareFunc)clip_clipboard_compare_entries);
-    GList *next = g_list_next(first);
-    if(first == NULL || next == NULL){
+    ClipboardText *current = clip_clipboard_text_ref(clip_clipboard_entry_get_text_buffer(entry));
+    clip_clipboard_entry_set_text(entry, text);
+
+    gboolean success = clip_clipboard_replace(clipboard, entry);
+    if(!success){
+        clip_clipboard_entry_set_text(entry, current);
+    }
+    clip_clipboard_text_unref(current);
+    return success;
+}
+
+/**
+ * Returns a reference to the entry after the given one in the history, or NULL if there isn't one.
+ */
+static ClipboardEntry* clip_clipboard_get_next(Clipboard *clipboard, ClipboardEntry *entry)
+{
+    ClipboardEntry *next = clip_history_get_next(clipboard->history, entry);
+    if(next == NULL){
         debug("Not enough entries to join.\n");
-        goto exit;
     }
+    return next;
+}
 
-    ClipboardEntry *right = next->data;
-    GString *joined_text = g_string_new(clip_clipboard_entry_get_text(left));
-    g_string_append_printf(joined_text, " %s", clip_clipboard_entry_get_text(right));
-    clip_clipboard_entry_set_text(left, joined_text->str);
-    g_string_free(joined_text, TRUE);
+static gboolean clip_clipboard_apply_join(Clipboard *clipboard, ClipboardEntry *left, ClipboardEntry *right,
+        ClipboardText *joined)
+{
+    ClipboardEntry *next = clip_clipboard_get_next(clipboard, left);
+    gboolean adjacent = next != NULL && clip_clipboard_entry_same(next, right);
+    clip_clipboard_entry_unref(next);
+    if(!adjacent){
+        debug("Joined entries are no longer adjacent.\n");
+        return FALSE;
+    }
 
-    clip_clipboard_remove(clipboard, right);
-    clip_clipboard_replace(clipboard, left);
-    changed = TRUE;
+    ClipboardText *left_text = clip_clipboard_text_ref(clip_clipboard_entry_get_text_buffer(left));
 
-exit:
-    clip_history_free_list(list);
+    // Removing the right and updating the left are one change.
+    clip_history_begin(clipboard->history);
+    clip_clipboard_entry_set_text(left, joined);
+    gboolean changed = clip_clipboard_remove(clipboard, right) && clip_clipboard_replace(clipboard, left);
+    if(!clip_history_end(clipboard->history, changed)){
+        clip_clipboard_entry_set_text(left, left_text);
+        changed = FALSE;
+    }
+    clip_clipboard_text_unref(left_text);
     return changed;
 }
 
-gboolean clip_clipboard_trim(Clipboard *clipboard, ClipboardEntry *entry)
+static void clip_clipboard_free_transform(ClipboardTransformJob *job)
 {
-    char *current = clip_clipboard_entry_get_text(entry);
-    g_strstrip(current);
-    return clip_clipboard_replace(clipboard, entry);
+    clip_clipboard_entry_unref(job->entry);
+    clip_clipboard_text_unref(job->text);
+    clip_clipboard_entry_unref(job->right);
+    clip_clipboard_text_unref(job->right_text);
+    g_object_unref(job->cancellable);
+    g_free(job);
 }
 
-gboolean clip_clipboard_to_upper(Clipboard *clipboard, ClipboardEntry *entry)
+/**
+ * Applies a finished transform, unless it was superseded or its entries changed while it ran.
+ */
+static void clip_clipboard_cb_transformed(ClipboardText *transformed, ClipboardTransformJob *job)
 {
-    char *current = clip_clipboard_entry_get_text(entry);
-    char *lower = g_utf8_strup(current, -1);
-    clip_clipboard_entry_set_text(entry, lower);
-    g_free(lower);
+    Clipboard *clipboard = job->clipboard;
+    if(clipboard == NULL || g_hash_table_lookup(clipboard->transforms, &job->id) != job){
+        debug("Dropping superseded transform.\n");
+        clip_clipboard_free_transform(job);
+        return;
+    }
+    g_hash_table_remove(clipboard->transforms, &job->id);
+
+    gboolean applied = FALSE;
+    ClipboardEntry *live = clip_history_get_entry(clipboard->history, job->id);
+    if(live == NULL){
+        debug("Entry was removed during transform.\n");
+    } else if(clip_clipboard_entry_get_text_buffer(job->entry) != job->text
+            || (job->right != NULL && clip_clipboard_entry_get_text_buffer(job->right) != job->right_text)){
+        debug("Entry changed during transform. Dropping it.\n");
+    } else if(transformed == NULL || transformed == job->text){
+        trace("Transform left the entry unchanged.\n");
+    } else if(job->right != NULL){
+        applied = clip_clipboard_apply_join(clipboard, job->entry, job->right, transformed);
+    } else {
+        applied = clip_clipboard_replace_text(clipboard, job->entry, transformed);
+    }
 
-    gboolean success = clip_clipboard_replace(clipboard, entry);
-    if(!success){
-        clip_clipboard_entry_set_text(entry, current);
+    // Saving a change notifies observers; otherwise they're told the entry is no longer pending.
+    if(live != NULL && !applied){
+        clip_events_notify(CLIPBOARD_UPDATE_EVENT, job->entry);
     }
-    return success;
+    clip_clipboard_entry_unref(live);
+    clip_clipboard_free_transform(job);
 }
 
-gboolean clip_clipboard_to_lower(Clipboard *clipboard, ClipboardEntry *entry)
+/**
+ * Starts transforming the entry on a worker, cancelling any transform of the entry still running. The entry is pending
+ * until the result is saved.
+ */
+static void clip_clipboard_start_transform(Clipboard *clipboard, ClipboardEntry *entry, ClipboardEntry *right,
+        ClipTransform transform)
+{
+    int64_t id = clip_clipboard_entry_get_id(entry);
+    ClipboardTransformJob *superseded = g_hash_table_lookup(clipboard->transforms, &id);
+    if(superseded != NULL){
+        debug("Cancelling superseded transform.\n");
+        g_hash_table_remove(clipboard->transforms, &id);
+        g_cancellable_cancel(superseded->cancellable);
+    }
+
+    ClipboardTransformJob *job = g_malloc(sizeof(ClipboardTransformJob));
+    job->clipboard = clipboard;
+    job->id = id;
+    job->entry = clip_clipboard_entry_ref(entry);
+    job->text = clip_clipboard_text_ref(clip_clipboard_entry_get_text_buffer(entry));
+    job->right = clip_clipboard_entry_ref(right);
+    job->right_text = right == NULL ? NULL : clip_clipboard_text_ref(clip_clipboard_entry_get_text_buffer(right));
+    job->cancellable = clip_transform_start(transform, job->text, job->right_text,
+            (ClipTransformCallback)clip_clipboard_cb_transformed, job);
+    g_hash_table_insert(clipboard->transforms, &job->id, job);
+
+    clip_events_notify(CLIPBOARD_UPDATE_EVENT, entry);
+}
+
+gboolean clip_clipboard_is_transforming(Clipboard *clipboard, int64_t id)
 {
-    char *current = clip_clipboard_entry_get_text(entry);
-    char *upper = g_utf8_strdown(current, -1);
-    clip_clipboard_entry_set_text(entry, upper);
-    g_free(upper);
+    return g_hash_table_contains(clipboard->transforms, &id);
+}
 
-    gboolean success = clip_clipboard_replace(clipboard, entry);
-    if(!success){
-        clip_clipboard_entry_set_text(entry, current);
+gboolean clip_clipboard_join(Clipboard *clipboard, ClipboardEntry *left)
+{
+    ClipboardEntry *right = clip_clipboard_get_next(clipboard, left);
+    if(right == NULL){
+        return FALSE;
     }
-    return success;
+    clip_clipboard_start_transform(clipboard, left, right, TRANSFORM_JOIN);
+    clip_clipboard_entry_unref(right);
+    return TRUE;
+}
+
+gboolean clip_clipboard_trim(Clipboard *clipboard, ClipboardEntry *entry)
+{
+    clip_clipboard_start_transform(clipboard, entry, NULL, TRANSFORM_TRIM);
+    return TRUE;
+}
+
+gboolean clip_clipboard_to_upper(Clipboard *clipboard, ClipboardEntry *entry)
+{
+    clip_clipboard_start_transform(clipboard, entry, NULL, TRANSFORM_UPPER);
+    return TRUE;
+}
+
+gboolean clip_clipboard_to_lower(Clipboard *clipboard, ClipboardEntry *entry)
+{
+    clip_clipboard_start_transform(clipboard, entry, NULL, TRANSFORM_LOWER);
+    return TRUE;
 }
 
 
 
 ClipboardEntry* clip_clipboard_get(Clipboard *clipboard)
 {
-    return clip_clipboard_entry_clone(clipboard->current);
+    return clip_clipboard_entry_ref(clipboard->current);
 }
 
 ClipboardEntry* clip_clipboard_get_head(Clipboard *clipboard)
@@ -284,21 +437,49 @@ ClipboardEntry* clip_clipboard_get_head(Clipboard *clipboard)
 
 gboolean clip_clipboard_is_head(Clipboard *clipboard, ClipboardEntry *entry)
 {
-    return !g_strcmp0(clip_clipboard_entry_get_text(clipboard->current), clip_clipboard_entry_get_text(entry));
+    return clip_clipboard_text_equals(clip_clipboard_entry_get_text_buffer(clipboard->current),
+            clip_clipboard_entry_get_text_buffer(entry));
+}
+
+gboolean clip_clipboard_is_head_text(Clipboard *clipboard, const char *text, gsize length)
+{
+    ClipboardText *current = clip_clipboard_entry_get_text_buffer(clipboard->current);
+    if(current == NULL || text == NULL){
+        return current == NULL && text == NULL;
+    }
+    return clip_clipboard_text_get_length(current) == length
+        && memcmp(clip_clipboard_text_get_str(current), text, length) == 0;
 }
 
 gboolean clip_clipboard_is_synced_with_provider(Clipboard *clipboard)
 {
-    char *provider_contents = clip_provider_get_current(clipboard->provider);
-    gboolean synced = !g_strcmp0(clipboard->current_text, provider_contents);
+    ClipboardText *provider_contents = clip_provider_get_current(clipboard->provider);
+    gboolean synced = clip_clipboard_text_equals(clipboard->current_text, provider_contents);
     clip_provider_free_current(provider_contents);
     return synced;
 }
 
+/**
+ * Captures the provider's value, applying the capture rules. A skipped value, or one from a transient source, becomes
+ * the current text, so it isn't captured again, but the current entry and the history are left as they were.
+ */
 void clip_clipboard_sync_with_provider(Clipboard *clipboard)
 {
-    char *provider_contents = clip_provider_get_current(clipboard->provider);
-    clip_clipboard_set_new(clipboard, provider_contents);
+    ClipboardText *provider_contents = clip_provider_get_current(clipboard->provider);
+    ClipFilterAction action = clip_provider_get_source(clipboard->provider) == SOURCE_TRANSIENT
+        ? FILTER_SKIP
+        : clip_filter_apply(clipboard->filter, provider_contents);
+    if(action == FILTER_SKIP){
+        debug("Not saving captured value.\n");
+        ClipboardText *existing_text = clipboard->current_text;
+        clipboard->current_text = clip_clipboard_text_ref(provider_contents);
+        clip_clipboard_text_unref(existing_text);
+    } else {
+        // The rules run before clip_clipboard_set, so the mask is already on the entry if it's merged into a similar one.
+        ClipboardEntry *entry = clip_clipboard_entry_new(0, provider_contents, FALSE, 0, 0, action == FILTER_MASK);
+        clip_clipboard_set(clipboard, entry, FALSE);
+        clip_clipboard_entry_unref(entry);
+    }
     clip_provider_free_current(provider_contents);
 }
 
@@ -335,25 +516,38 @@ gboolean clip_clipboard_toggle_lock(Clipboard *clipboard, ClipboardEntry *entry)
 {
     gboolean locked = clip_clipboard_entry_get_locked(entry);
     clip_clipboard_entry_set_locked(entry, !locked);
-    return clip_history_update(clipboard->history, entry);
+    if(!clip_history_update_locked(clipboard->history, entry)){
+        clip_clipboard_entry_set_locked(entry, locked);
+        return FALSE;
+    }
+    return TRUE;
 }
 
 gboolean clip_clipboard_toggle_mask(Clipboard *clipboard, ClipboardEntry *entry)
 {
     gboolean masked = clip_clipboard_entry_is_masked(entry);
     clip_clipboard_entry_set_masked(entry, !masked);
-    return clip_history_update(clipboard->history, entry);
+    if(!clip_history_update_masked(clipboard->history, entry)){
+        clip_clipboard_entry_set_masked(entry, masked);
+        return FALSE;
+    }
+    return TRUE;
 }
 
 
 gboolean clip_clipboard_tag(Clipboard *clipboard, ClipboardEntry *entry, char tag)
 {
-    if(clip_clipboard_entry_get_tag(entry) == tag) {
+    char old_tag = clip_clipboard_entry_get_tag(entry);
+    if(old_tag == tag) {
         clip_clipboard_entry_remove_tag(entry);
     } else {
         clip_clipboard_entry_set_tag(entry, tag);
     }
-    return clip_history_update(clipboard->history, entry);
+    if(!clip_history_update_tag(clipboard->history, entry)){
+        clip_clipboard_entry_set_tag(entry, old_tag);
+        return FALSE;
+    }
+    return TRUE;
 }
 
 
@@ -362,7 +556,7 @@ void clip_clipboard_clear(Clipboard *clipboard)
     clip_history_clear(clipboard->history);
     clip_provider_clear(clipboard->provider);
 
-    clip_clipboard_entry_free(clipboard->current);
+    clip_clipboard_entry_unref(clipboard->current);
     clipboard->current = NULL;
 }
 
@@ -397,14 +591,34 @@ void clip_clipboard_disable_history(Clipboard *clipboard)
 
 
 
-GList* clip_clipboard_get_history(Clipboard *clipboard)
+ClipboardHistorySnapshot* clip_clipboard_get_snapshot(Clipboard *clipboard)
+{
+    return clip_history_get_snapshot(clipboard->history);
+}
+
+ClipboardEntry* clip_clipboard_get_entry(Clipboard *clipboard, int64_t id)
+{
+    return clip_history_get_entry(clipboard->history, id);
+}
+
+ClipboardEntry* clip_clipboard_get_tagged(Clipboard *clipboard, char tag)
+{
+    return clip_history_get_tagged(clipboard->history, tag);
+}
+
+ClipboardEntry* clip_clipboard_get_nth(Clipboard *clipboard, guint n)
+{
+    return clip_history_get_nth(clipboard->history, n);
+}
+
+GList* clip_clipboard_search(Clipboard *clipboard, const char *term, int limit)
 {
-    return clip_history_get_list(clipboard->history);
+    return clip_history_search(clipboard->history, term, limit);
 }
 
-void clip_clipboard_free_history(GList *history)
+GArray* clip_clipboard_search_ids(Clipboard *clipboard, const char *term)
 {
-    clip_history_free_list(history);
+    return clip_history_search_ids(clipboard->history, term);
 }
 
 
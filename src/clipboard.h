@@ -20,6 +20,7 @@
  */
 
 #include "clipboard_entry.h"
+#include "history_snapshot.h"
 #include "provider.h"
 
 #include <glib.h>
@@ -36,26 +37,27 @@ void clip_clipboard_free(Clipboard *clipboard);
 
 
 /**
- * Gets a copy of the current clipboard's contents. This copy must be
- * freed when no longer used.
+ * Gets a reference to the current clipboard's entry. This reference must be
+ * released when no longer used.
  */
 ClipboardEntry* clip_clipboard_get(Clipboard *clipboard);
 /**
- * Gets a copy of the clipboard's inactive contents. This copy must be
- * freed whe no longer in use.
+ * Gets a reference to the clipboard's inactive entry. This reference must be
+ * released when no longer in use.
  */
 ClipboardEntry* clip_clipboard_get_head(Clipboard *clipboard);
 /**
  * Identifies if the specified entry is the current entry of the clipboard.
  */
 gboolean clip_clipboard_is_head(Clipboard *clipboard, ClipboardEntry *entry);
+gboolean clip_clipboard_is_head_text(Clipboard *clipboard, const char *text, gsize length);
 
 gboolean clip_clipboard_is_synced_with_provider(Clipboard *clipboard);
 void clip_clipboard_sync_with_provider(Clipboard *clipboard);
 
 
 /**
- * Sets the clipboard's current value to a copy of the current entry. This has
+ * Sets the clipboard's current value to the current entry. This has
  * the same characteristics as set_new. Sometimes, Clip thinks it knows best
  * whether or not the clipboard should be set (say, perhaps, the shift key
  * is still depressed and PRIMARY is used as a source). In instances like these,
@@ -63,11 +65,11 @@ void clip_clipboard_sync_with_provider(Clipboard *clipboard);
  */
 void clip_clipboard_set(Clipboard *clipboard, ClipboardEntry *entry, gboolean force);
 /**
- * Sets the clipboards current value to a copy of the specified text. If text is
- * NULL, the current clipboard value, along with its associated history entry,
- * are purged.
+ * Sets the clipboards current value to the specified text. If text is NULL,
+ * the current clipboard value, along with its associated history entry, are
+ * purged.
  */
-void clip_clipboard_set_new(Clipboard *clipboard, char *text);
+void clip_clipboard_set_new(Clipboard *clipboard, ClipboardText *text);
 
 
 /**
@@ -79,6 +81,11 @@ gboolean clip_clipboard_remove(Clipboard *clipboard, ClipboardEntry *entry);
  * clipboard value.
  */
 gboolean clip_clipboard_replace(Clipboard *clipboard, ClipboardEntry *entry);
+/**
+ * Replaces the entry's text with the new text and saves it, restoring the old
+ * text if the change can't be saved.
+ */
+gboolean clip_clipboard_replace_text(Clipboard *clipboard, ClipboardEntry *entry, ClipboardText *text);
 /**
  * Clear the clipboard.
  */
@@ -91,11 +98,16 @@ void clip_clipboard_clear(Clipboard *clipboard);
 /**
  * Join the specified entry with its next adjacent entry. This will not modify 
  * the clipboard's current state.
+ * <br />
+ * Joins, trims and case changes run in the background and return whether one
+ * was started. The entry is transforming until the result is saved, which
+ * notifies an update. A later transform of the same entry supersedes it.
  */
 gboolean clip_clipboard_join(Clipboard *clipboard, ClipboardEntry *left);
 gboolean clip_clipboard_trim(Clipboard *clipboard, ClipboardEntry *entry);
 gboolean clip_clipboard_to_upper(Clipboard *clipboard, ClipboardEntry *entry);
 gboolean clip_clipboard_to_lower(Clipboard *clipboard, ClipboardEntry *entry);
+gboolean clip_clipboard_is_transforming(Clipboard *clipboard, int64_t id);
 gboolean clip_clipboard_toggle_lock(Clipboard *clipboard, ClipboardEntry *entry);
 gboolean clip_clipboard_toggle_mask(Clipboard *clipboard, ClipboardEntry *entry);
 gboolean clip_clipboard_tag(Clipboard *clipboard, ClipboardEntry *entry, char tag);
@@ -111,5 +123,9 @@ TrimMode clip_clipboard_next_trim_mode(Clipboard *clipboard);
 TrimMode clip_clipboard_get_trim_mode(Clipboard *clipboard);
 
 
-GList* clip_clipboard_get_history(Clipboard *clipboard);
-void clip_clipboard_free_history(GList *history);
+ClipboardHistorySnapshot* clip_clipboard_get_snapshot(Clipboard *clipboard);
+ClipboardEntry* clip_clipboard_get_entry(Clipboard *clipboard, int64_t id);
+ClipboardEntry* clip_clipboard_get_tagged(Clipboard *clipboard, char tag);
+ClipboardEntry* clip_clipboard_get_nth(Clipboard *clipboard, guint n);
+GList* clip_clipboard_search(Clipboard *clipboard, const char *term, int limit);
+GArray* clip_clipboard_search_ids(Clipboard *clipboard, const char *term);
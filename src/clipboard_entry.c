@@ -22,67 +22,116 @@
 #include "clipboard_entry.h"
 
 struct clipboard_entry {
+    gint refs;
+    guint version;
     uint64_t id;
-    char *text;
+    ClipboardText *text;
     unsigned int count;
     char tag;
     gboolean locked;
     gboolean masked;
+    ClipboardEntryNotify finalize_notify;
+    gpointer finalize_data;
 };
 
+// Versions are unique across all entries, so a version alone identifies an entry's state.
+static gint versions = 0;
 
-ClipboardEntry* clip_clipboard_entry_new(int64_t id, char *text, gboolean locked, unsigned int count, char tag, gboolean masked)
+static guint clip_clipboard_entry_next_version(void)
+{
+    return g_atomic_int_add(&versions, 1) + 1;
+}
+
+ClipboardEntry* clip_clipboard_entry_new(int64_t id, ClipboardText *text, gboolean locked, unsigned int count, char tag, gboolean masked)
 {
     ClipboardEntry *entry = g_malloc(sizeof(ClipboardEntry));
+    entry->refs = 1;
+    entry->version = clip_clipboard_entry_next_version();
     entry->id = id;
-    entry->text = g_strdup(text);
+    entry->text = clip_clipboard_text_ref(text);
     entry->locked = locked;
     entry->count = count;
     entry->tag = tag;
     entry->masked = masked;
+    entry->finalize_notify = NULL;
+    entry->finalize_data = NULL;
     return entry;
 }
 
-ClipboardEntry* clip_clipboard_entry_clone(ClipboardEntry *entry)
+ClipboardEntry* clip_clipboard_entry_ref(ClipboardEntry *entry)
 {
     if(entry == NULL){
         return NULL;
     }
-    return clip_clipboard_entry_new(entry->id, entry->text, entry->locked, entry->count, entry->tag, entry->masked);
+    g_atomic_int_inc(&entry->refs);
+    return entry;
 }
 
-void clip_clipboard_entry_free(ClipboardEntry *entry)
+void clip_clipboard_entry_unref(ClipboardEntry *entry)
 {
-    if(entry == NULL){
+    if(entry == NULL || !g_atomic_int_dec_and_test(&entry->refs)){
         return;
     }
-    g_free(entry->text);
+    if(entry->finalize_notify != NULL){
+        entry->finalize_notify(entry, entry->finalize_data);
+    }
+    clip_clipboard_text_unref(entry->text);
     g_free(entry);
 }
 
+void clip_clipboard_entry_set_finalize_notify(ClipboardEntry *entry, ClipboardEntryNotify notify, gpointer user_data)
+{
+    entry->finalize_notify = notify;
+    entry->finalize_data = user_data;
+}
+
+guint clip_clipboard_entry_get_version(ClipboardEntry *entry)
+{
+    if(entry == NULL){
+        return 0;
+    }
+    return entry->version;
+}
 
 gboolean clip_clipboard_entry_is_new(ClipboardEntry *entry)
 {
     return entry->id == 0;
 }
 
-char* clip_clipboard_entry_get_text(ClipboardEntry *entry)
+const char* clip_clipboard_entry_get_text(ClipboardEntry *entry)
 {
     if(entry == NULL){
         return NULL;
     }
     entry->count++;
+    return clip_clipboard_text_get_str(entry->text);
+}
+
+ClipboardText* clip_clipboard_entry_get_text_buffer(ClipboardEntry *entry)
+{
+    if(entry == NULL){
+        return NULL;
+    }
     return entry->text;
 }
 
-void clip_clipboard_entry_set_text(ClipboardEntry *entry, char *text)
+gsize clip_clipboard_entry_get_length(ClipboardEntry *entry)
+{
+    if(entry == NULL){
+        return 0;
+    }
+    return clip_clipboard_text_get_length(entry->text);
+}
+
+void clip_clipboard_entry_set_text(ClipboardEntry *entry, ClipboardText *text)
 {
     if(entry == NULL){
         return;
     }
-    char *old_text = entry->text;
-    entry->text = g_strdup(text);
-    g_free(old_text);
+    ClipboardText *old_text = entry->text;
+    entry->text = clip_clipboard_text_ref(text);
+    entry->version = clip_clipboard_entry_next_version();
+    clip_clipboard_text_unref(old_text);
 }
 
 
@@ -102,11 +151,13 @@ gboolean clip_clipboard_entry_has_tag(ClipboardEntry *entry, char tag)
 void clip_clipboard_entry_set_tag(ClipboardEntry *entry, char tag)
 {
     entry->tag = tag;
+    entry->version = clip_clipboard_entry_next_version();
 }
 
 void clip_clipboard_entry_remove_tag(ClipboardEntry *entry)
 {
     entry->tag = 0;
+    entry->version = clip_clipboard_entry_next_version();
 }
 
 
@@ -142,6 +193,7 @@ gboolean clip_clipboard_entry_get_locked(ClipboardEntry *entry)
 void clip_clipboard_entry_set_locked(ClipboardEntry *entry, gboolean locked)
 {
     entry->locked = locked;
+    entry->version = clip_clipboard_entry_next_version();
 }
 
 
@@ -153,7 +205,7 @@ gboolean clip_clipboard_entry_equals(ClipboardEntry *a, ClipboardEntry *b)
     } else if(a == NULL || b == NULL) {
         return FALSE;
     }
-    return a->id == b->id || !g_strcmp0(a->text, b->text);
+    return a->id == b->id || clip_clipboard_text_equals(a->text, b->text);
 }
 
 gboolean clip_clipboard_entry_same(ClipboardEntry *a, ClipboardEntry *b)
@@ -174,4 +226,5 @@ gboolean clip_clipboard_entry_is_masked(ClipboardEntry *entry)
 void clip_clipboard_entry_set_masked(ClipboardEntry *entry, gboolean masked)
 {
     entry->masked = masked;
+    entry->version = clip_clipboard_entry_next_version();
 }
@@ -19,28 +19,50 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include "clipboard_text.h"
+
 #include <glib.h>
 #include <inttypes.h>
 
 typedef struct clipboard_entry ClipboardEntry;
+typedef void (*ClipboardEntryNotify)(ClipboardEntry *entry, gpointer user_data);
 
-ClipboardEntry* clip_clipboard_entry_new(int64_t id, char *text, gboolean locked, unsigned int count, char tag, gboolean masked);
-ClipboardEntry* clip_clipboard_entry_clone(ClipboardEntry *entry);
-void clip_clipboard_entry_free(ClipboardEntry *entry);
+/**
+ * Creates a new entry with a single reference. Entries are shared rather than copied: the history keeps exactly one
+ * live entry per id, so any change made to an entry is visible to everyone holding a reference to it.
+ */
+ClipboardEntry* clip_clipboard_entry_new(int64_t id, ClipboardText *text, gboolean locked, unsigned int count, char tag, gboolean masked);
+ClipboardEntry* clip_clipboard_entry_ref(ClipboardEntry *entry);
+void clip_clipboard_entry_unref(ClipboardEntry *entry);
+/**
+ * Sets the function called when the last reference to the entry is released, just before it's freed. An entry has at
+ * most one; NULL removes it. This lets an index refer to an entry without keeping it alive.
+ */
+void clip_clipboard_entry_set_finalize_notify(ClipboardEntry *entry, ClipboardEntryNotify notify, gpointer user_data);
 
+/**
+ * Returns the entry's version. Every change to the entry's text or flags gives it a new version, never used before by
+ * any entry.
+ */
+guint clip_clipboard_entry_get_version(ClipboardEntry *entry);
 gboolean clip_clipboard_entry_is_new(ClipboardEntry *entry);
 
 uint64_t clip_clipboard_entry_get_id(ClipboardEntry *entry);
 void clip_clipboard_entry_set_id(ClipboardEntry *entry, uint64_t id);
 
 /**
- * Return a pointer to the entry's text.
+ * Return a pointer to the entry's text. This value must not be modified.
+ */
+const char* clip_clipboard_entry_get_text(ClipboardEntry *entry);
+/**
+ * Return the entry's shared text buffer. The caller must take its own reference to keep it.
  */
-char* clip_clipboard_entry_get_text(ClipboardEntry *entry);
+ClipboardText* clip_clipboard_entry_get_text_buffer(ClipboardEntry *entry);
+gsize clip_clipboard_entry_get_length(ClipboardEntry *entry);
 /**
- * Change the entry's text.
+ * Change the entry's text. The entry takes its own reference to the buffer.
  */
-void clip_clipboard_entry_set_text(ClipboardEntry *entry, char *text);
+void clip_clipboard_entry_set_text(ClipboardEntry *entry, ClipboardText *text);
 
 char clip_clipboard_entry_get_tag(ClipboardEntry *entry);
 gboolean clip_clipboard_entry_has_tag(ClipboardEntry *entry, char tag);
@@ -57,7 +79,7 @@ void clip_clipboard_entry_set_locked(ClipboardEntry *entry, gboolean locked);
  */
 gboolean clip_clipboard_entry_equals(ClipboardEntry *a, ClipboardEntry *b);
 /**
- * Determines if the two entries are the same entry (by ID).
+ * Determines if the two entries are the same entry (by identity or ID).
  */
 gboolean clip_clipboard_entry_same(ClipboardEntry *a, ClipboardEntry *b);
 
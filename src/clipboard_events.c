@@ -25,12 +25,98 @@
 #include <glib.h>
 
 static GList *observers;
+static GList *batch_observers;
+
+// Events waiting for the batch observers, and the position of each entry's event in the batch, by id.
+static GArray *batch = NULL;
+static GHashTable *batch_index = NULL;
+static guint batch_source = 0;
+
 
 void clip_events_add_observer(void (*clip_event_listener)(ClipboardEvent event, ClipboardEntry* entry))
 {
     observers = g_list_prepend(observers, clip_event_listener);
 }
 
+void clip_events_add_batch_observer(void (*clip_event_batch_listener)(GArray *events))
+{
+    if(batch == NULL){
+        batch = g_array_new(FALSE, FALSE, sizeof(ClipboardEventRecord));
+        batch_index = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+    }
+    batch_observers = g_list_prepend(batch_observers, clip_event_batch_listener);
+}
+
+static void clip_events_batch_clear(void)
+{
+    for(guint i = 0; i < batch->len; i++){
+        clip_clipboard_entry_unref(g_array_index(batch, ClipboardEventRecord, i).entry);
+    }
+    g_array_set_size(batch, 0);
+    g_hash_table_remove_all(batch_index);
+}
+
+/**
+ * Indexes the entry's queued event at the position.
+ */
+static void clip_events_batch_index(int64_t id, guint position)
+{
+    int64_t *key = g_new(int64_t, 1);
+    *key = id;
+    // Positions are stored one higher, so that the first isn't NULL.
+    g_hash_table_replace(batch_index, key, GUINT_TO_POINTER(position + 1));
+}
+
+/**
+ * Removes the event at the position. The events after it move up, so their positions are re-indexed.
+ */
+static void clip_events_batch_remove(guint position)
+{
+    clip_clipboard_entry_unref(g_array_index(batch, ClipboardEventRecord, position).entry);
+    g_array_remove_index(batch, position);
+    for(guint i = position; i < batch->len; i++){
+        int64_t id = clip_clipboard_entry_get_id(g_array_index(batch, ClipboardEventRecord, i).entry);
+        if(g_hash_table_lookup(batch_index, &id) == GUINT_TO_POINTER(i + 2)){
+            clip_events_batch_index(id, i);
+        }
+    }
+}
+
+static gboolean clip_events_cb_flush(gpointer user_data)
+{
+    batch_source = 0;
+    clip_events_flush();
+    return G_SOURCE_REMOVE;
+}
+
+static void clip_events_batch(ClipboardEvent event, ClipboardEntry *entry)
+{
+    if(event == CLIPBOARD_CLEAR_EVENT){
+        clip_events_batch_clear();
+    } else {
+        // Positions are stored one higher, so that the first isn't NULL.
+        int64_t id = clip_clipboard_entry_get_id(entry);
+        guint position = GPOINTER_TO_UINT(g_hash_table_lookup(batch_index, &id));
+        ClipboardEventRecord *queued = position == 0 ? NULL : &g_array_index(batch, ClipboardEventRecord, position - 1);
+        if(queued != NULL && queued->event != CLIPBOARD_REMOVE_EVENT){
+            if(event == CLIPBOARD_UPDATE_EVENT){
+                ClipboardEntry *previous = queued->entry;
+                queued->entry = clip_clipboard_entry_ref(entry);
+                clip_clipboard_entry_unref(previous);
+                return;
+            }
+            clip_events_batch_remove(position - 1);
+        }
+        clip_events_batch_index(id, batch->len);
+    }
+
+    ClipboardEventRecord record = { event, clip_clipboard_entry_ref(entry) };
+    g_array_append_val(batch, record);
+    if(batch_source == 0){
+        batch_source = g_idle_add(clip_events_cb_flush, NULL);
+    }
+}
+
 void clip_events_notify(ClipboardEvent event, ClipboardEntry *entry)
 {
     trace("Firing event %d for %"PRIu64".\n", event, clip_clipboard_entry_get_id(entry));
@@ -40,4 +126,36 @@ void clip_events_notify(ClipboardEvent event, ClipboardEntry *entry)
         func(event, entry);
         next = g_list_next(next);
     }
+    if(batch_observers != NULL){
+        clip_events_batch(event, entry);
+    }
+}
+
+void clip_events_flush(void)
+{
+    if(batch_source != 0){
+        g_source_remove(batch_source);
+        batch_source = 0;
+    }
+    if(batch == NULL || batch->len == 0){
+        return;
+    }
+
+    // Observers may fire more events, which start the next batch.
+    GArray *delivering = batch;
+    batch = g_array_new(FALSE, FALSE, sizeof(ClipboardEventRecord));
+    g_hash_table_remove_all(batch_index);
+    trace("Delivering a batch of %u events.\n", delivering->len);
+
+    GList *next = g_list_first(batch_observers);
+    while(next != NULL){
+        void (*func)() = next->data;
+        func(delivering);
+        next = g_list_next(next);
+    }
+
+    for(guint i = 0; i < delivering->len; i++){
+        clip_clipboard_entry_unref(g_array_index(delivering, ClipboardEventRecord, i).entry);
+    }
+    g_array_free(delivering, TRUE);
 }
@@ -25,8 +25,24 @@
 #ifndef __CLIP_EVENTS_TYPES__
 #define __CLIP_EVENTS_TYPES__
 typedef enum {CLIPBOARD_ADD_EVENT, CLIPBOARD_REMOVE_EVENT, CLIPBOARD_UPDATE_EVENT, CLIPBOARD_CLEAR_EVENT} ClipboardEvent;
+
+typedef struct {
+    ClipboardEvent event;
+    ClipboardEntry *entry;
+} ClipboardEventRecord;
 #endif
 
 void clip_events_add_observer(void (*clip_event_listener)(ClipboardEvent event, ClipboardEntry* entry));
+/**
+ * Adds an observer that receives events in batches, as an array of ClipboardEventRecord. Events are queued, collapsed
+ * by entry, and delivered together in idle time or when flushed. An update following an add or an update of the same
+ * entry is merged into it; an add or a remove replaces any earlier add or update of the entry; a clear drops every
+ * earlier event.
+ */
+void clip_events_add_batch_observer(void (*clip_event_batch_listener)(GArray *events));
 
 void clip_events_notify(ClipboardEvent event, ClipboardEntry *entry);
+/**
+ * Delivers the queued batch now. Call this once an operation is complete, when its changes must be seen straight away.
+ */
+void clip_events_flush(void);
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "clipboard_text.h"
+#include "ascii.h"
+
+#include <string.h>
+
+struct clipboard_text {
+    gint refs;
+    gsize length;
+    char *str;
+    char inline_str[];
+};
+
+
+ClipboardText* clip_clipboard_text_new(const char *text, gssize length)
+{
+    if(text == NULL){
+        return NULL;
+    }
+    gsize actual = length < 0 ? strlen(text) : (gsize)length;
+    ClipboardText *buffer = g_malloc(sizeof(ClipboardText) + actual + 1);
+    buffer->refs = 1;
+    buffer->length = actual;
+    buffer->str = buffer->inline_str;
+    memcpy(buffer->inline_str, text, actual);
+    buffer->inline_str[actual] = '\0';
+    return buffer;
+}
+
+ClipboardText* clip_clipboard_text_new_take(char *text, gssize length)
+{
+    if(text == NULL){
+        return NULL;
+    }
+    ClipboardText *buffer = g_malloc(sizeof(ClipboardText));
+    buffer->refs = 1;
+    buffer->length = length < 0 ? strlen(text) : (gsize)length;
+    buffer->str = text;
+    return buffer;
+}
+
+ClipboardText* clip_clipboard_text_ref(ClipboardText *text)
+{
+    if(text == NULL){
+        return NULL;
+    }
+    g_atomic_int_inc(&text->refs);
+    return text;
+}
+
+void clip_clipboard_text_unref(ClipboardText *text)
+{
+    if(text == NULL || !g_atomic_int_dec_and_test(&text->refs)){
+        return;
+    }
+    if(text->str != text->inline_str){
+        g_free(text->str);
+    }
+    text->str = NULL;
+    g_free(text);
+}
+
+
+const char* clip_clipboard_text_get_str(ClipboardText *text)
+{
+    if(text == NULL){
+        return NULL;
+    }
+    return text->str;
+}
+
+gsize clip_clipboard_text_get_length(ClipboardText *text)
+{
+    if(text == NULL){
+        return 0;
+    }
+    return text->length;
+}
+
+gboolean clip_clipboard_text_equals(ClipboardText *a, ClipboardText *b)
+{
+    if(a == b){
+        return TRUE;
+    } else if(a == NULL || b == NULL){
+        return FALSE;
+    } else if(a->length != b->length){
+        return FALSE;
+    }
+    return !memcmp(a->str, b->str, a->length);
+}
+
+
+void clip_clipboard_text_get_trimmed_bounds(ClipboardText *text, gboolean left, gboolean right, gsize *start, gsize *end)
+{
+    gsize first = 0;
+    gsize last = clip_clipboard_text_get_length(text);
+    if(left){
+        first = clip_ascii_span_space(text->str, last);
+    }
+    if(right){
+        last -= clip_ascii_span_space_reverse(text->str + first, last - first);
+    }
+    *start = first;
+    *end = last;
+}
+
+ClipboardText* clip_clipboard_text_trim(ClipboardText *text, gboolean left, gboolean right)
+{
+    if(text == NULL){
+        return NULL;
+    }
+    gsize start, end;
+    clip_clipboard_text_get_trimmed_bounds(text, left, right, &start, &end);
+    if(start == 0 && end == text->length){
+        return clip_clipboard_text_ref(text);
+    }
+    return clip_clipboard_text_new(text->str + start, end - start);
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+
+typedef struct clipboard_text ClipboardText;
+
+/**
+ * Creates a new, immutable text buffer holding a copy of text. If length is negative, text must be NUL-terminated. The
+ * buffer and its payload are a single allocation. Returns NULL if text is NULL.
+ */
+ClipboardText* clip_clipboard_text_new(const char *text, gssize length);
+/**
+ * Creates a new, immutable text buffer that takes ownership of the g_malloc'd, NUL-terminated text without copying it.
+ * Returns NULL if text is NULL.
+ */
+ClipboardText* clip_clipboard_text_new_take(char *text, gssize length);
+
+ClipboardText* clip_clipboard_text_ref(ClipboardText *text);
+void clip_clipboard_text_unref(ClipboardText *text);
+
+/**
+ * Return a pointer to the buffer's NUL-terminated payload. This value must not be modified.
+ */
+const char* clip_clipboard_text_get_str(ClipboardText *text);
+gsize clip_clipboard_text_get_length(ClipboardText *text);
+/**
+ * Determines if the two buffers hold the same bytes. Lengths are compared before the payload.
+ */
+gboolean clip_clipboard_text_equals(ClipboardText *a, ClipboardText *b);
+
+/**
+ * Find the bounds of the text once leading and/or trailing whitespace is ignored.
+ */
+void clip_clipboard_text_get_trimmed_bounds(ClipboardText *text, gboolean left, gboolean right, gsize *start, gsize *end);
+/**
+ * Return a buffer without leading and/or trailing whitespace. If there is nothing to trim, this is a new reference
+ * to the same buffer.
+ */
+ClipboardText* clip_clipboard_text_trim(ClipboardText *text, gboolean left, gboolean right);
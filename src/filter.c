@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "filter.h"
+#include "config.h"
+#include "histogram.h"
+#include "utils.h"
+
+#include <string.h>
+
+typedef struct {
+    ClipFilterAction action;
+    ClipFilterKind kind;
+    const char *pattern;
+} FilterRule;
+
+static const FilterRule rules[] = { CAPTURE_RULES { FILTER_KEEP, FILTER_LITERAL, NULL } };
+
+/**
+ * A state of the Aho-Corasick automaton. Failure links are folded into the transitions, so scanning takes one lookup
+ * per byte, and into the outputs, so a state's action covers every literal ending there.
+ */
+typedef struct {
+    gint32 next[256];
+    ClipFilterAction action;
+    // The first rule with the state's action.
+    gint rule;
+} FilterState;
+
+typedef struct {
+    GRegex *regex;
+    ClipFilterAction action;
+    gint rule;
+    ClipHistogram *histogram;
+} FilterRegex;
+
+struct filter {
+    GArray *states;
+    ClipHistogram *literal_histogram;
+    GArray *regexes;
+};
+
+
+static gint32 clip_filter_add_state(GArray *states)
+{
+    FilterState state;
+    memset(state.next, 0xff, sizeof(state.next));
+    state.action = FILTER_KEEP;
+    state.rule = -1;
+    g_array_append_val(states, state);
+    return states->len - 1;
+}
+
+static void clip_filter_add_literal(GArray *states, const char *literal, ClipFilterAction action, gint rule)
+{
+    gint32 current = 0;
+    for(const char *c = literal; *c != '\0'; c++){
+        gint32 next = g_array_index(states, FilterState, current).next[(guchar)*c];
+        if(next < 0){
+            next = clip_filter_add_state(states);
+            g_array_index(states, FilterState, current).next[(guchar)*c] = next;
+        }
+        current = next;
+    }
+
+    FilterState *state = &g_array_index(states, FilterState, current);
+    if(action > state->action){
+        state->action = action;
+        state->rule = rule;
+    }
+}
+
+/**
+ * Turns the trie into a DFA: each missing transition takes the transition of the state's failure link, found breadth
+ * first so that shallower states are always complete first.
+ */
+static void clip_filter_link_states(GArray *states)
+{
+    gint32 *failures = g_new0(gint32, states->len);
+    GQueue queue = G_QUEUE_INIT;
+
+    FilterState *root = &g_array_index(states, FilterState, 0);
+    for(guint c = 0; c < 256; c++){
+        if(root->next[c] < 0){
+            root->next[c] = 0;
+        } else {
+            g_queue_push_tail(&queue, GINT_TO_POINTER(root->next[c]));
+        }
+    }
+
+    while(!g_queue_is_empty(&queue)){
+        gint32 current = GPOINTER_TO_INT(g_queue_pop_head(&queue));
+        for(guint c = 0; c < 256; c++){
+            FilterState *state = &g_array_index(states, FilterState, current);
+            FilterState *failure = &g_array_index(states, FilterState, failures[current]);
+            gint32 next = state->next[c];
+            if(next < 0){
+                state->next[c] = failure->next[c];
+                continue;
+            }
+
+            failures[next] = failure->next[c];
+            FilterState *child = &g_array_index(states, FilterState, next);
+            FilterState *child_failure = &g_array_index(states, FilterState, failures[next]);
+            if(child_failure->action > child->action){
+                child->action = child_failure->action;
+                child->rule = child_failure->rule;
+            }
+            g_queue_push_tail(&queue, GINT_TO_POINTER(next));
+        }
+    }
+    g_free(failures);
+}
+
+ClipFilter* clip_filter_new(void)
+{
+    ClipFilter *filter = g_malloc(sizeof(ClipFilter));
+    filter->states = g_array_new(FALSE, FALSE, sizeof(FilterState));
+    filter->regexes = g_array_new(FALSE, FALSE, sizeof(FilterRegex));
+    filter->literal_histogram = NULL;
+    clip_filter_add_state(filter->states);
+
+    guint literals = 0;
+    for(gint i = 0; rules[i].pattern != NULL; i++){
+        if(rules[i].kind == FILTER_LITERAL){
+            if(rules[i].pattern[0] == '\0'){
+                warn("Ignoring empty capture rule %d.\n", i);
+                continue;
+            }
+            clip_filter_add_literal(filter->states, rules[i].pattern, rules[i].action, i);
+            literals++;
+            continue;
+        }
+
+        GError *error = NULL;
+        GRegex *regex = g_regex_new(rules[i].pattern, G_REGEX_OPTIMIZE, 0, &error);
+        if(regex == NULL){
+            warn("Ignoring capture rule %d, '%s': %s\n", i, rules[i].pattern, error->message);
+            g_error_free(error);
+            continue;
+        }
+        char *name = g_strdup_printf("Capture rule %d (%s)", i, rules[i].pattern);
+        FilterRegex compiled = { regex, rules[i].action, i, clip_histogram_new(name) };
+        g_free(name);
+        g_array_append_val(filter->regexes, compiled);
+    }
+
+    if(literals > 0){
+        clip_filter_link_states(filter->states);
+        filter->literal_histogram = clip_histogram_new("Capture rules (literals)");
+    }
+    debug("Compiled %u literal capture rules into %u states, and %u regex rules.\n", literals, filter->states->len,
+            filter->regexes->len);
+    return filter;
+}
+
+void clip_filter_free(ClipFilter *filter)
+{
+    if(filter == NULL){
+        return;
+    }
+    if(filter->literal_histogram != NULL){
+        clip_histogram_log(filter->literal_histogram);
+        clip_histogram_free(filter->literal_histogram);
+    }
+    for(guint i = 0; i < filter->regexes->len; i++){
+        FilterRegex *compiled = &g_array_index(filter->regexes, FilterRegex, i);
+        clip_histogram_log(compiled->histogram);
+        clip_histogram_free(compiled->histogram);
+        g_regex_unref(compiled->regex);
+    }
+    g_array_free(filter->regexes, TRUE);
+    g_array_free(filter->states, TRUE);
+    g_free(filter);
+}
+
+/**
+ * Scans the text once for every literal. The scan stops early once a literal to skip is found.
+ */
+static ClipFilterAction clip_filter_scan_literals(ClipFilter *filter, const char *text, gsize length, gint *rule)
+{
+    const FilterState *states = (const FilterState*)filter->states->data;
+    ClipFilterAction action = FILTER_KEEP;
+    gint32 current = 0;
+    for(gsize i = 0; i < length && action < FILTER_SKIP; i++){
+        current = states[current].next[(guchar)text[i]];
+        if(states[current].action > action){
+            action = states[current].action;
+            *rule = states[current].rule;
+        }
+    }
+    return action;
+}
+
+ClipFilterAction clip_filter_apply(ClipFilter *filter, ClipboardText *text)
+{
+    if(text == NULL){
+        return FILTER_KEEP;
+    }
+    const char *str = clip_clipboard_text_get_str(text);
+    gsize length = clip_clipboard_text_get_length(text);
+    ClipFilterAction action = FILTER_KEEP;
+    gint rule = -1;
+
+    if(filter->literal_histogram != NULL){
+        gint64 start = g_get_monotonic_time();
+        action = clip_filter_scan_literals(filter, str, length, &rule);
+        clip_histogram_record(filter->literal_histogram, g_get_monotonic_time() - start);
+    }
+
+    // A regex is only run if it could strengthen the action.
+    for(guint i = 0; i < filter->regexes->len && action < FILTER_SKIP; i++){
+        FilterRegex *compiled = &g_array_index(filter->regexes, FilterRegex, i);
+        if(compiled->action <= action){
+            continue;
+        }
+        gint64 start = g_get_monotonic_time();
+        gboolean matched = g_regex_match_full(compiled->regex, str, length, 0, 0, NULL, NULL);
+        clip_histogram_record(compiled->histogram, g_get_monotonic_time() - start);
+        if(matched){
+            action = compiled->action;
+            rule = compiled->rule;
+        }
+    }
+
+    if(action != FILTER_KEEP){
+        debug("Captured value matches capture rule %d.\n", rule);
+    }
+    return action;
+}
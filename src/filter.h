@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "clipboard_text.h"
+
+#include <glib.h>
+
+#ifndef __CLIP_FILTER_TYPES__
+#define __CLIP_FILTER_TYPES__
+/**
+ * What to do with a captured value. Actions are ordered by strength: when rules disagree, the strongest wins.
+ */
+typedef enum {FILTER_KEEP, FILTER_MASK, FILTER_SKIP} ClipFilterAction;
+typedef enum {FILTER_LITERAL, FILTER_REGEX} ClipFilterKind;
+
+typedef struct filter ClipFilter;
+#endif
+
+/**
+ * Compiles the CAPTURE_RULES. Every literal is compiled into one automaton, so they're all found in a single pass over
+ * the text; each regex is compiled once. Rules that don't compile are logged and ignored.
+ */
+ClipFilter* clip_filter_new(void);
+void clip_filter_free(ClipFilter *filter);
+
+/**
+ * Returns the strongest action of the rules matching the text. The time each regex rule takes, and the time the
+ * literals take together, are recorded in histograms logged when the filter is freed.
+ */
+ClipFilterAction clip_filter_apply(ClipFilter *filter, ClipboardText *text);
@@ -0,0 +1,392 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "fuzzy.h"
+
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__SSE2__) && defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define FUZZY_AVX2 1
+#endif
+
+/*
+ * Scores follow fzf's: each matched character scores SCORE_MATCH, gaps are penalised, and characters at word boundaries
+ * or continuing a run of matches earn a bonus.
+ */
+#define SCORE_MATCH 16
+#define SCORE_GAP_START -3
+#define SCORE_GAP_EXTENSION -1
+#define BONUS_BOUNDARY (SCORE_MATCH / 2)
+#define BONUS_BOUNDARY_WHITE (BONUS_BOUNDARY + 2)
+#define BONUS_BOUNDARY_DELIMITER (BONUS_BOUNDARY + 1)
+#define BONUS_NON_WORD (SCORE_MATCH / 2)
+#define BONUS_CAMEL (BONUS_BOUNDARY - 1)
+#define BONUS_CONSECUTIVE (-(SCORE_GAP_START + SCORE_GAP_EXTENSION))
+#define BONUS_FIRST_CHAR_MULTIPLIER 2
+
+// Queries up to this length keep their match positions on the stack.
+#define FUZZY_STACK_POSITIONS 64
+
+typedef enum { CLASS_NON_WORD, CLASS_WHITE, CLASS_DELIMITER, CLASS_LOWER, CLASS_UPPER, CLASS_NUMBER } CharClass;
+
+struct fuzzy_pattern {
+    gsize length;
+    // The query with ASCII letters folded to lower case, and the bits to set in a text byte before comparing it to the
+    // folded query: 0x20 for letters, so that either case matches, and nothing for anything else.
+    char *folded;
+    char *fold;
+};
+
+typedef gboolean (*FuzzyForwardFunc)(const ClipFuzzyPattern *pattern, gsize i, gsize stop, const char *position,
+        const char *text, const char *end, const char **positions);
+typedef const char* (*FuzzyBackwardFunc)(const ClipFuzzyPattern *pattern, const char *match_end, const char *text,
+        const char *end);
+
+// Chosen once, on first use, by the CPU's features.
+static FuzzyForwardFunc find_forward = NULL;
+static FuzzyBackwardFunc find_backward = NULL;
+// The bonus for a character of a class after one of another, filled in on first use.
+static gint8 bonuses[CLASS_NUMBER + 1][CLASS_NUMBER + 1];
+
+
+static gboolean clip_fuzzy_is(const ClipFuzzyPattern *pattern, gsize i, char c)
+{
+    return (char)(c | pattern->fold[i]) == pattern->folded[i];
+}
+
+/**
+ * Finds the query's characters from the ith up to stop, in order, each at its first occurrence after the last, searching
+ * [position, end) of the text [text, end). Writes where each was found to positions and returns TRUE if all of them
+ * were.
+ */
+static gboolean clip_fuzzy_find_forward_scalar(const ClipFuzzyPattern *pattern, gsize i, gsize stop,
+        const char *position, const char *text, const char *end, const char **positions)
+{
+    for(; i < stop && position < end; position++){
+        if(clip_fuzzy_is(pattern, i, *position)){
+            positions[i++] = position;
+        }
+    }
+    return i == stop;
+}
+
+/**
+ * Finds the query's characters in reverse order, each at its last occurrence before the one after it, searching back
+ * from match_end in the text [text, end). Every character must occur. Returns where the first character was found.
+ */
+static const char* clip_fuzzy_find_backward_scalar(const ClipFuzzyPattern *pattern, const char *match_end,
+        const char *text, const char *end)
+{
+    gsize i = pattern->length;
+    const char *position = match_end;
+    while(TRUE){
+        position--;
+        if(clip_fuzzy_is(pattern, i - 1, *position) && --i == 0){
+            return position;
+        }
+    }
+}
+
+/*
+ * The vector searches are the prefilter: most texts in a large history are rejected 16 or 64 bytes at a time, before
+ * any scoring is done. A chunk is searched for as many of the query's characters as it holds before moving on, since
+ * matches in real text are usually close together, and each chunk costs a mispredicted branch. Chunks at the ends of
+ * the text are read from inside it, overlapping their neighbours, and their masks shifted into place, so nothing past
+ * the text is read and only texts shorter than a chunk are searched a byte at a time.
+ */
+#ifdef __SSE2__
+static guint32 clip_fuzzy_chunk_mask_sse2(const ClipFuzzyPattern *pattern, gsize i, __m128i chunk)
+{
+    __m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(pattern->fold[i]));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(folded, _mm_set1_epi8(pattern->folded[i])));
+}
+
+static gboolean clip_fuzzy_find_forward_sse2(const ClipFuzzyPattern *pattern, gsize i, gsize stop,
+        const char *position, const char *text, const char *end, const char **positions)
+{
+    if(end - text < 16){
+        return clip_fuzzy_find_forward_scalar(pattern, i, stop, position, text, end, positions);
+    }
+    for(; i < stop && position < end; position += 16){
+        const char *start = MIN(position, end - 16);
+        __m128i chunk = _mm_loadu_si128((const __m128i*)start);
+        guint shift = position - start;
+        guint32 mask = clip_fuzzy_chunk_mask_sse2(pattern, i, chunk) >> shift;
+        while(mask != 0){
+            guint offset = __builtin_ctz(mask);
+            positions[i++] = position + offset;
+            if(i == stop){
+                return TRUE;
+            }
+            // Only the bytes after this match.
+            mask = (clip_fuzzy_chunk_mask_sse2(pattern, i, chunk) >> shift) & (0xfffeu << offset);
+        }
+    }
+    return i == stop;
+}
+
+static const char* clip_fuzzy_find_backward_sse2(const ClipFuzzyPattern *pattern, const char *match_end,
+        const char *text, const char *end)
+{
+    if(end - text < 16){
+        return clip_fuzzy_find_backward_scalar(pattern, match_end, text, end);
+    }
+    gsize i = pattern->length;
+    const char *position = match_end;
+    while(TRUE){
+        const char *start = MAX(position - 16, text);
+        __m128i chunk = _mm_loadu_si128((const __m128i*)start);
+        guint32 mask = clip_fuzzy_chunk_mask_sse2(pattern, i - 1, chunk) & ((1u << (position - start)) - 1);
+        while(mask != 0){
+            guint offset = 31 - __builtin_clz(mask);
+            if(--i == 0){
+                return start + offset;
+            }
+            // Only the bytes before this match.
+            mask = clip_fuzzy_chunk_mask_sse2(pattern, i - 1, chunk) & ((1u << offset) - 1);
+        }
+        position = start;
+    }
+}
+#endif
+
+#ifdef FUZZY_AVX2
+__attribute__((target("avx2")))
+static guint32 clip_fuzzy_chunk_mask_avx2(const ClipFuzzyPattern *pattern, gsize i, __m256i chunk)
+{
+    __m256i folded = _mm256_or_si256(chunk, _mm256_set1_epi8(pattern->fold[i]));
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8(pattern->folded[i])));
+}
+
+__attribute__((target("avx2")))
+static guint64 clip_fuzzy_window_mask_avx2(const ClipFuzzyPattern *pattern, gsize i, __m256i low, __m256i high)
+{
+    return clip_fuzzy_chunk_mask_avx2(pattern, i, low) | (guint64)clip_fuzzy_chunk_mask_avx2(pattern, i, high) << 32;
+}
+
+__attribute__((target("avx2")))
+static gboolean clip_fuzzy_find_forward_avx2(const ClipFuzzyPattern *pattern, gsize i, gsize stop,
+        const char *position, const char *text, const char *end, const char **positions)
+{
+    if(end - text < 64){
+        return clip_fuzzy_find_forward_sse2(pattern, i, stop, position, text, end, positions);
+    }
+    for(; i < stop && position < end; position += 64){
+        const char *start = MIN(position, end - 64);
+        __m256i low = _mm256_loadu_si256((const __m256i*)start);
+        __m256i high = _mm256_loadu_si256((const __m256i*)(start + 32));
+        guint shift = position - start;
+        guint64 mask = clip_fuzzy_window_mask_avx2(pattern, i, low, high) >> shift;
+        while(mask != 0){
+            guint offset = __builtin_ctzll(mask);
+            positions[i++] = position + offset;
+            if(i == stop || offset == 63){
+                break;
+            }
+            // Only the bytes after this match.
+            mask = (clip_fuzzy_window_mask_avx2(pattern, i, low, high) >> shift) & (~G_GUINT64_CONSTANT(1) << offset);
+        }
+    }
+    return i == stop;
+}
+
+__attribute__((target("avx2")))
+static const char* clip_fuzzy_find_backward_avx2(const ClipFuzzyPattern *pattern, const char *match_end,
+        const char *text, const char *end)
+{
+    if(end - text < 64){
+        return clip_fuzzy_find_backward_sse2(pattern, match_end, text, end);
+    }
+    gsize i = pattern->length;
+    const char *position = match_end;
+    while(TRUE){
+        const char *start = MAX(position - 64, text);
+        __m256i low = _mm256_loadu_si256((const __m256i*)start);
+        __m256i high = _mm256_loadu_si256((const __m256i*)(start + 32));
+        guint length = position - start;
+        guint64 mask = clip_fuzzy_window_mask_avx2(pattern, i - 1, low, high);
+        mask &= length == 64 ? ~G_GUINT64_CONSTANT(0) : (G_GUINT64_CONSTANT(1) << length) - 1;
+        while(mask != 0){
+            guint offset = 63 - __builtin_clzll(mask);
+            if(--i == 0){
+                return start + offset;
+            }
+            // Only the bytes before this match.
+            mask = clip_fuzzy_window_mask_avx2(pattern, i - 1, low, high) & ((G_GUINT64_CONSTANT(1) << offset) - 1);
+        }
+        position = start;
+    }
+}
+#endif
+
+// Multibyte characters are treated as letters.
+static const guint8 classes[256] = {
+    ['a' ... 'z'] = CLASS_LOWER,
+    ['A' ... 'Z'] = CLASS_UPPER,
+    ['0' ... '9'] = CLASS_NUMBER,
+    [' '] = CLASS_WHITE, ['\t'] = CLASS_WHITE, ['\n'] = CLASS_WHITE, ['\r'] = CLASS_WHITE,
+    ['/'] = CLASS_DELIMITER, [','] = CLASS_DELIMITER, [':'] = CLASS_DELIMITER, [';'] = CLASS_DELIMITER,
+    ['|'] = CLASS_DELIMITER,
+    [0x80 ... 0xff] = CLASS_LOWER,
+};
+
+static gint clip_fuzzy_get_bonus(CharClass previous, CharClass current)
+{
+    if(current >= CLASS_LOWER){
+        if(previous == CLASS_WHITE){
+            return BONUS_BOUNDARY_WHITE;
+        } else if(previous == CLASS_DELIMITER){
+            return BONUS_BOUNDARY_DELIMITER;
+        } else if(previous == CLASS_NON_WORD){
+            return BONUS_BOUNDARY;
+        }
+    }
+
+    if((previous == CLASS_LOWER && current == CLASS_UPPER) || (previous != CLASS_NUMBER && current == CLASS_NUMBER)){
+        return BONUS_CAMEL;
+    } else if(current == CLASS_NON_WORD || current == CLASS_DELIMITER){
+        return BONUS_NON_WORD;
+    } else if(current == CLASS_WHITE){
+        return BONUS_BOUNDARY_WHITE;
+    }
+    return 0;
+}
+
+static void clip_fuzzy_init(void)
+{
+    static gsize initialized = 0;
+    if(!g_once_init_enter(&initialized)){
+        return;
+    }
+#if defined(FUZZY_AVX2)
+    if(__builtin_cpu_supports("avx2")){
+        find_forward = clip_fuzzy_find_forward_avx2;
+        find_backward = clip_fuzzy_find_backward_avx2;
+    } else {
+        find_forward = clip_fuzzy_find_forward_sse2;
+        find_backward = clip_fuzzy_find_backward_sse2;
+    }
+#elif defined(__SSE2__)
+    find_forward = clip_fuzzy_find_forward_sse2;
+    find_backward = clip_fuzzy_find_backward_sse2;
+#else
+    find_forward = clip_fuzzy_find_forward_scalar;
+    find_backward = clip_fuzzy_find_backward_scalar;
+#endif
+    for(CharClass previous = 0; previous <= CLASS_NUMBER; previous++){
+        for(CharClass current = 0; current <= CLASS_NUMBER; current++){
+            bonuses[previous][current] = clip_fuzzy_get_bonus(previous, current);
+        }
+    }
+    g_once_init_leave(&initialized, 1);
+}
+
+
+ClipFuzzyPattern* clip_fuzzy_pattern_new(const char *query)
+{
+    clip_fuzzy_init();
+    ClipFuzzyPattern *pattern = g_malloc(sizeof(ClipFuzzyPattern));
+    pattern->length = strlen(query);
+    pattern->folded = g_ascii_strdown(query, pattern->length);
+    pattern->fold = g_malloc(pattern->length + 1);
+    for(gsize i = 0; i < pattern->length; i++){
+        pattern->fold[i] = g_ascii_islower(pattern->folded[i]) ? 0x20 : 0;
+    }
+    return pattern;
+}
+
+void clip_fuzzy_pattern_free(ClipFuzzyPattern *pattern)
+{
+    if(pattern == NULL){
+        return;
+    }
+    g_free(pattern->folded);
+    g_free(pattern->fold);
+    g_free(pattern);
+}
+
+/**
+ * Scores the matched characters at positions.
+ */
+static gint clip_fuzzy_score(const ClipFuzzyPattern *pattern, const char *text, const char **positions)
+{
+    const char *start = positions[0];
+    CharClass previous = start == text ? CLASS_WHITE : classes[(guint8)start[-1]];
+    gint first_bonus = bonuses[previous][classes[(guint8)*start]];
+    gint score = SCORE_MATCH + first_bonus * BONUS_FIRST_CHAR_MULTIPLIER;
+
+    for(gsize i = 1; i < pattern->length; i++){
+        const char *match = positions[i];
+        gssize gap = match - positions[i - 1] - 1;
+        gint bonus = bonuses[classes[(guint8)match[-1]]][classes[(guint8)*match]];
+        // A run of matches keeps the bonus of its first character. Both cases are worked out, so that choosing one
+        // doesn't need a branch on the text.
+        gint run_first_bonus = bonus >= BONUS_BOUNDARY && bonus > first_bonus ? bonus : first_bonus;
+        gint run_bonus = MAX(MAX(bonus, run_first_bonus), BONUS_CONSECUTIVE);
+        gint gap_bonus = bonus + SCORE_GAP_START + (gint)(gap - 1) * SCORE_GAP_EXTENSION;
+        first_bonus = gap > 0 ? bonus : run_first_bonus;
+        score += SCORE_MATCH + (gap > 0 ? gap_bonus : run_bonus);
+    }
+    return score;
+}
+
+/**
+ * Finds the first match by scanning forward, then shortens it by scanning backward from its end, so that it's scored
+ * over the tightest window ending at the same character. The window is scored by matching forward again from its start.
+ */
+gboolean clip_fuzzy_match(const ClipFuzzyPattern *pattern, const char *text, gsize length, gint *score)
+{
+    if(pattern->length == 0){
+        *score = 0;
+        return TRUE;
+    }
+
+    const char *stack_positions[FUZZY_STACK_POSITIONS];
+    const char **positions = stack_positions;
+    if(pattern->length > FUZZY_STACK_POSITIONS){
+        positions = g_new(const char*, pattern->length);
+    }
+
+    const char *end = text + length;
+    gboolean found = find_forward(pattern, 0, pattern->length, text, text, end, positions);
+    if(found){
+        const char *match_end = positions[pattern->length - 1] + 1;
+        positions[0] = find_backward(pattern, match_end, text, end);
+        // Matching forward again from the window's start can only move characters the first match found before the
+        // previous one. From the first character it found after, the matches are the same.
+        for(gsize i = 1; i < pattern->length && positions[i] <= positions[i - 1]; i++){
+            if(clip_fuzzy_is(pattern, i, positions[i - 1][1])){
+                positions[i] = positions[i - 1] + 1;
+            } else {
+                find_forward(pattern, i, i + 1, positions[i - 1] + 1, text, match_end, positions);
+            }
+        }
+        *score = clip_fuzzy_score(pattern, text, positions);
+    }
+
+    if(positions != stack_positions){
+        g_free(positions);
+    }
+    return found;
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+
+typedef struct fuzzy_pattern ClipFuzzyPattern;
+
+/**
+ * Compiles a query for fuzzy matching. A text matches if it contains every character of the query, in order. ASCII
+ * letters match either case.
+ */
+ClipFuzzyPattern* clip_fuzzy_pattern_new(const char *query);
+void clip_fuzzy_pattern_free(ClipFuzzyPattern *pattern);
+
+/**
+ * Tests the text against the pattern. If it matches, score is set to how well it matches; matches which are compact and
+ * start at word boundaries score higher.
+ */
+gboolean clip_fuzzy_match(const ClipFuzzyPattern *pattern, const char *text, gsize length, gint *score);
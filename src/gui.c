@@ -21,8 +21,12 @@
 
 #include "gui.h"
 #include "gui_editor.h"
+#include "gui_list.h"
 #include "gui_search.h"
+#include "gui_view.h"
+#include "histogram.h"
 #include "keybinder.h"
+#include "paste.h"
 
 #include "config.h"
 #include "clipboard_events.h"
@@ -48,12 +52,55 @@ static GtkWidget *menu_item_exit = NULL;
 static gboolean marking = FALSE;
 static gboolean finding = FALSE;
 static int rows = 0;
+static const GuiView *view = NULL;
 
+// History rows follow the search item and its separator.
+#define GUI_FIRST_ROW_POSITION 2
+static ClipboardHistorySnapshot *snapshot = NULL;
+
+/**
+ * Rows are rendered from the menu's snapshot. The live entry is only loaded when an action needs it, or when the
+ * entry is updated while the menu is shown.
+ */
 typedef struct {
+    int64_t id;
+    guint snapshot_row;
     ClipboardEntry *entry;
     int row;
+    // The tag the row is indexed under, or 0.
+    char indexed_tag;
+    // The key the label was last rendered with.
+    GuiRowKey rendered;
 } Data;
 
+// The history rows' menu items in history order, and indexes from entry id and tag to menu item.
+static GPtrArray *row_items = NULL;
+static GHashTable *id_items = NULL;
+static GHashTable *tag_items = NULL;
+
+// Removed history rows, kept with their data for reuse.
+static GQueue *item_pool = NULL;
+
+// Set while only some rows are shown, in ranked order.
+static gboolean filtered = FALSE;
+// Set while the rows are exactly the snapshot's rows.
+static gboolean snapshot_current = FALSE;
+
+typedef struct {
+    ClipboardEvent event;
+    ClipboardEntry *entry;
+} GuiEvent;
+
+// History changes waiting to be applied to the menu.
+static GQueue *pending_events = NULL;
+static guint prepare_source = 0;
+
+// The time the hotkey was last pressed, until the view is visible.
+static gint64 hotkey_time = 0;
+static ClipHistogram *hotkey_latency = NULL;
+// Keys typed after the hotkey, waiting for the view to be shown.
+static GQueue *type_ahead = NULL;
+
 
 
 static gboolean clip_gui_menu_item_is_selectable(GtkWidget *widget)
@@ -78,25 +125,15 @@ static Data* clip_gui_get_data(GtkWidget *menu_item)
     return g_object_get_data(G_OBJECT(menu_item), "data");
 }
 
-static GtkWidget* clip_gui_menu_item_find(GCompareFunc compare)
+static GtkWidget* clip_gui_menu_item_find_for_entry(ClipboardEntry *entry)
 {
-    GList *children = gtk_container_get_children(GTK_CONTAINER(menu));
-    GList *found_child = g_list_find_custom(children, NULL, compare);
-    GtkWidget *found = found_child == NULL ? NULL : found_child->data;
-    g_list_free(children);
-    return found;
+    int64_t id = clip_clipboard_entry_get_id(entry);
+    return g_hash_table_lookup(id_items, &id);
 }
 
-static GtkWidget* clip_gui_menu_item_find_for_entry(ClipboardEntry *entry)
+static GtkWidget* clip_gui_menu_item_find_for_row(int row)
 {
-    gint compare(GtkWidget *widget) {
-        Data *data = clip_gui_get_data(widget);
-        if(data == NULL){
-            return -1;
-        }
-        return !clip_clipboard_entry_equals(entry, data->entry);
-    }
-    return clip_gui_menu_item_find((GCompareFunc)compare);
+    return row < 0 || row >= (int)row_items->len ? NULL : g_ptr_array_index(row_items, row);
 }
 
 static void clip_gui_activate_menu_item(GtkWidget *widget)
@@ -110,22 +147,68 @@ static void clip_gui_activate_menu_item(GtkWidget *widget)
     gtk_menu_shell_deactivate(GTK_MENU_SHELL(menu));
 }
 
+/**
+ * Returns the row's live entry, loading it from the history the first time it's needed.
+ */
+static ClipboardEntry* clip_gui_data_get_entry(Data *data)
+{
+    if(data->entry == NULL){
+        data->entry = clip_clipboard_get_entry(clipboard, data->id);
+    }
+    return data->entry;
+}
+
+static const char* clip_gui_data_get_text(Data *data)
+{
+    return data->entry != NULL
+        ? clip_clipboard_entry_get_text(data->entry)
+        : clip_history_snapshot_get_text(snapshot, data->snapshot_row);
+}
+
+static gsize clip_gui_data_get_length(Data *data)
+{
+    return data->entry != NULL
+        ? clip_clipboard_entry_get_length(data->entry)
+        : clip_history_snapshot_get_text_length(snapshot, data->snapshot_row);
+}
+
+static gboolean clip_gui_data_is_locked(Data *data)
+{
+    return data->entry != NULL
+        ? clip_clipboard_entry_get_locked(data->entry)
+        : clip_history_snapshot_is_locked(snapshot, data->snapshot_row);
+}
+
+static gboolean clip_gui_data_is_masked(Data *data)
+{
+    return data->entry != NULL
+        ? clip_clipboard_entry_is_masked(data->entry)
+        : clip_history_snapshot_is_masked(snapshot, data->snapshot_row);
+}
+
+static char clip_gui_data_get_tag(Data *data)
+{
+    return data->entry != NULL
+        ? clip_clipboard_entry_get_tag(data->entry)
+        : clip_history_snapshot_get_tag(snapshot, data->snapshot_row);
+}
+
 static ClipboardEntry* clip_gui_get_entry(GtkWidget *menu_item)
 {
     Data *data = clip_gui_get_data(menu_item);
     if(data == NULL){
         return NULL;
     }
-    return data->entry;
+    return clip_gui_data_get_entry(data);
 }
 
-static ClipboardEntry* clip_gui_get_entry_copy(GtkWidget *menu_item)
+/**
+ * Returns a new reference to the menu item's entry. The reference keeps the entry alive even if the menu item is
+ * removed while it's in use.
+ */
+static ClipboardEntry* clip_gui_get_entry_ref(GtkWidget *menu_item)
 {
-    ClipboardEntry *entry = clip_gui_get_entry(menu_item);
-    if(entry == NULL){
-        return NULL;
-    }
-    return clip_clipboard_entry_clone(entry);
+    return clip_clipboard_entry_ref(clip_gui_get_entry(menu_item));
 }
 
 
@@ -143,50 +226,54 @@ static void clip_gui_set_markedup_label(GtkBin *item, char *format, char *text)
     g_free(markedup);
 }
 
-static void clip_gui_menu_item_update(GtkWidget *menu_item)
+static void clip_gui_data_get_row(Data *data, GuiRow *row)
 {
-    Data *data = clip_gui_get_data(menu_item);
-    if(data == NULL){
-        warn("Got an update action for a missing entry.\n");
-        return;
-    }
-
-    char *text = clip_clipboard_entry_get_text(data->entry);
-    char *shortened = clip_clipboard_entry_is_masked(data->entry)
-        ? g_strnfill(MIN(GUI_DISPLAY_CHARACTERS, strlen(text)), GUI_MASK_CHAR)
-        : g_strndup(text, GUI_DISPLAY_CHARACTERS);
-
-    GString *mask = g_string_new("%s");
+    row->row = data->row;
+    row->id = data->id;
+    row->version = clip_clipboard_entry_get_version(data->entry);
+    row->text = clip_gui_data_get_text(data);
+    row->length = clip_gui_data_get_length(data);
+    row->locked = clip_gui_data_is_locked(data);
+    row->masked = clip_gui_data_is_masked(data);
+    row->tag = clip_gui_data_get_tag(data);
+}
 
-    if(clip_clipboard_entry_get_locked(data->entry)){
-        g_string_prepend(mask, "<b>");
-        g_string_append(mask, "</b>");
+/**
+ * Indexes the row under its current tag. Tags are unique, so a row taking a tag replaces any row still indexed under
+ * it.
+ */
+static void clip_gui_menu_item_index_tag(GtkWidget *menu_item, Data *data, char tag)
+{
+    if(data->indexed_tag == tag){
+        return;
     }
-
-    if(clip_clipboard_is_head(clipboard, data->entry)){
-        g_string_prepend(mask, "<i>");
-        g_string_append(mask, "</i>");
+    if(data->indexed_tag != 0 && g_hash_table_lookup(tag_items, GINT_TO_POINTER(data->indexed_tag)) == menu_item){
+        g_hash_table_remove(tag_items, GINT_TO_POINTER(data->indexed_tag));
     }
-
-    char tag = clip_clipboard_entry_get_tag(data->entry);
     if(tag != 0){
-        GString *tagged = g_string_new("");
-        g_string_printf(tagged, "<span foreground='gray'>%c</span> %s", tag, mask->str);
-        g_string_free(mask, TRUE);
-        mask = tagged;
+        g_hash_table_insert(tag_items, GINT_TO_POINTER(tag), menu_item);
     }
+    data->indexed_tag = tag;
+}
 
-    if(data->row < 10){
-        GString *numbered = g_string_new("");
-        g_string_printf(numbered, "<span foreground='gray'>%d</span> %s", data->row, mask->str);
-        g_string_free(mask, TRUE);
-        mask = numbered;
+static void clip_gui_menu_item_update(GtkWidget *menu_item)
+{
+    Data *data = clip_gui_get_data(menu_item);
+    if(data == NULL){
+        warn("Got an update action for a missing entry.\n");
+        return;
     }
 
-    clip_gui_set_markedup_label(GTK_BIN(menu_item), mask->str, shortened);
-
-    g_string_free(mask, TRUE);
-    g_free(shortened);
+    GuiRow row;
+    GuiRowKey key;
+    clip_gui_data_get_row(data, &row);
+    clip_gui_menu_item_index_tag(menu_item, data, row.tag);
+    clip_gui_view_get_key(clipboard, &row, &key);
+    if(clip_gui_view_key_equals(&key, &data->rendered)){
+        return;
+    }
+    gtk_label_set_markup(GTK_LABEL(gtk_bin_get_child(GTK_BIN(menu_item))), clip_gui_view_render_row(clipboard, &row));
+    data->rendered = key;
 }
 
 static void clip_gui_menu_item_change_entry(GtkWidget *menu_item, ClipboardEntry *entry)
@@ -194,11 +281,15 @@ static void clip_gui_menu_item_change_entry(GtkWidget *menu_item, ClipboardEntry
     Data *data = clip_gui_get_data(menu_item);
     if(data == NULL){
         warn("Got an update action for a missing entry.\n");
+        return;
     }
 
-    ClipboardEntry *old_entry = data->entry;
-    data->entry = clip_clipboard_entry_clone(entry);
-    clip_clipboard_entry_free(old_entry);
+    // Entries are shared with the history, so the row already sees the change.
+    if(data->entry != entry){
+        ClipboardEntry *old_entry = data->entry;
+        data->entry = clip_clipboard_entry_ref(entry);
+        clip_clipboard_entry_unref(old_entry);
+    }
 
     clip_gui_menu_item_update(menu_item);
 }
@@ -217,229 +308,289 @@ static void clip_gui_menu_update(void)
     clip_gui_set_normal_label(GTK_BIN(menu_item_history), history_text);
 
 
-    char *mode_name = GUI_AUTO_TRIM_MESSAGE;
-    switch(clip_clipboard_get_trim_mode(clipboard)){
-        case TRIM_OFF:
-        case TRIM_STOP:  mode_name = GUI_AUTO_TRIM_MESSAGE " (Off)"; break;
-        case TRIM_CHOMP: mode_name = GUI_AUTO_TRIM_MESSAGE " (Trim Right)"; break;
-        case TRIM_CHUG:  mode_name = GUI_AUTO_TRIM_MESSAGE " (Trim Left)"; break;
-        case TRIM_STRIP: mode_name = GUI_AUTO_TRIM_MESSAGE " (Trim Both)"; break;
-    }
-    clip_gui_set_normal_label(GTK_BIN(menu_item_trim), mode_name);
+    const char *mode_name = clip_gui_view_trim_label(clip_clipboard_get_trim_mode(clipboard));
+    clip_gui_set_normal_label(GTK_BIN(menu_item_trim), (char*)mode_name);
 }
 
 
 
 
 
+static void clip_gui_menu_item_free(GtkWidget *menu_item)
+{
+    Data *data = g_object_get_data(G_OBJECT(menu_item), "data");
+    g_object_set_data(G_OBJECT(menu_item),"data", NULL);
+    g_free(data);
+    gtk_widget_destroy(menu_item);
+    g_object_unref(menu_item);
+}
+
 /**
- * Remove the specified menu item.
+ * Remove the specified menu item. History rows are returned to the pool.
  */
 static void clip_gui_menu_item_remove(GtkWidget *menu_item)
 {
+    if(menu_item == NULL){
+        return;
+    }
     Data *data = clip_gui_get_data(menu_item);
     if(data != NULL){
-        g_object_set_data(G_OBJECT(menu_item),"data", NULL);
-        clip_clipboard_entry_free(data->entry);
+        clip_gui_menu_item_index_tag(menu_item, data, 0);
+        if(g_hash_table_lookup(id_items, &data->id) == menu_item){
+            g_hash_table_remove(id_items, &data->id);
+        }
+        clip_clipboard_entry_unref(data->entry);
         data->entry = NULL;
+        data->id = 0;
         data->row = 0;
-        g_free(data);
+        memset(&data->rendered, 0, sizeof(GuiRowKey));
+        if(g_queue_get_length(item_pool) < HISTORY_MAX_SIZE){
+            g_queue_push_tail(item_pool, g_object_ref(menu_item));
+        } else {
+            g_object_set_data(G_OBJECT(menu_item),"data", NULL);
+            g_free(data);
+        }
     }
     gtk_container_remove(GTK_CONTAINER(menu), menu_item);
 }
 
-static void clip_gui_do_delete(GtkWidget *menu_item)
+static void clip_gui_do_delete(ClipboardEntry *selected)
 {
-    GtkWidget *selected_item = clip_gui_get_selected_item();
-    if(selected_item == NULL){
+    if(selected == NULL){
         warn("Trying to remove a selected item, but no item is selected.\n");
         return;
     }
 
     //FIXME: I don't belong here.
-    ClipboardEntry *entry = clip_gui_get_entry_copy(selected_item);
-    if(!clip_clipboard_entry_get_locked(entry)){
-        clip_clipboard_remove(clipboard, entry);
+    if(!clip_clipboard_entry_get_locked(selected)){
+        clip_clipboard_remove(clipboard, selected);
     } else {
         debug("Refusing to delete locked item.\n");
     }
-    clip_clipboard_entry_free(entry);
 }
 
-static void clip_gui_do_lock(GtkWidget *selected_menu_item)
+static void clip_gui_do_lock(ClipboardEntry *selected)
 {
-    if(selected_menu_item == NULL){
+    if(selected == NULL){
         trace("Tried to lock with no item selected.\n");
         return;
     }
-    ClipboardEntry *entry = clip_gui_get_entry_copy(selected_menu_item);
-    clip_clipboard_toggle_lock(clipboard, entry);
-    clip_clipboard_entry_free(entry);
+    clip_clipboard_toggle_lock(clipboard, selected);
 }
 
-static void clip_gui_do_edit(GtkWidget *selected_menu_item, gboolean promote)
+typedef struct {
+    ClipboardEntry *entry;
+    // The text the editor was opened with. The edit is spliced into it, so it's only valid while the entry has it.
+    ClipboardText *original;
+    gboolean promote;
+} GuiEdit;
+
+static void clip_gui_free_edit(GuiEdit *edit)
 {
-    if(!clip_clipboard_is_enabled(clipboard) || selected_menu_item == NULL){
-        trace("Clipboard is disabled or no item is selected.\n");
+    clip_clipboard_entry_unref(edit->entry);
+    clip_clipboard_text_unref(edit->original);
+    g_free(edit);
+}
+
+static void clip_gui_cb_edited(char *edited, GuiEdit *edit)
+{
+    if(edited == NULL){
+        debug("Edited text is unchanged. Ignoring edit request.\n");
+        return;
+    }
+    ClipboardEntry *live = clip_clipboard_get_entry(clipboard, clip_clipboard_entry_get_id(edit->entry));
+    clip_clipboard_entry_unref(live);
+    if(live == NULL){
+        debug("Edited entry was removed while it was being edited. Ignoring edit request.\n");
+        clip_gui_editor_free_text(edited);
         return;
     }
 
-    trace("Editing current value.\n");
-    gtk_menu_shell_deactivate(GTK_MENU_SHELL(menu));
+    // Setting the same text again gives the entry a new buffer, which isn't a conflicting change.
+    if(!clip_clipboard_text_equals(clip_clipboard_entry_get_text_buffer(edit->entry), edit->original)){
+        warn("Edited entry was changed while it was being edited. Ignoring edit request.\n");
+        clip_gui_editor_free_text(edited);
+        return;
+    }
 
-    ClipboardEntry *selected_entry = clip_gui_get_entry_copy(selected_menu_item);
-    clip_clipboard_disable_history(clipboard);
-    char *current = clip_clipboard_entry_get_text(selected_entry);
-    char *edited = clip_gui_editor_edit_text(current);
-    clip_clipboard_enable_history(clipboard);
+    // The buffer adopts the edited text, so it isn't freed here.
+    ClipboardText *text = clip_clipboard_text_new_take(edited, -1);
+    gboolean saved = clip_clipboard_replace_text(clipboard, edit->entry, text);
+    clip_clipboard_text_unref(text);
+    if(saved && edit->promote){
+        clip_clipboard_set(clipboard, edit->entry, TRUE);
+    }
+    view->update();
+}
 
-    if(edited != NULL){
-        clip_clipboard_entry_set_text(selected_entry, edited);
-        if(promote){
-            clip_clipboard_set(clipboard, selected_entry, TRUE);
-        } else {
-            clip_clipboard_replace(clipboard, selected_entry);
-        }
-        clip_gui_menu_update();
-    } else {
-        debug("Edited text is unchanged. Ignoring edit request.\n");
+/**
+ * Opens an editor for the entry. The editor is a window of its own, so the history keeps being captured, and the pop-up
+ * keeps working, while it's open.
+ */
+static void clip_gui_do_edit(ClipboardEntry *selected, gboolean promote)
+{
+    if(!clip_clipboard_is_enabled(clipboard) || selected == NULL){
+        trace("Clipboard is disabled or no item is selected.\n");
+        return;
     }
-    clip_gui_editor_free_text(edited);
-    clip_clipboard_entry_free(selected_entry);
+
+    trace("Editing current value.\n");
+    view->hide();
+
+    GuiEdit *edit = g_malloc(sizeof(GuiEdit));
+    edit->entry = clip_clipboard_entry_ref(selected);
+    edit->original = clip_clipboard_text_ref(clip_clipboard_entry_get_text_buffer(selected));
+    edit->promote = promote;
+    clip_gui_editor_edit_text(clip_clipboard_entry_get_text(selected), (GuiEditorCallback)clip_gui_cb_edited, edit,
+            (GDestroyNotify)clip_gui_free_edit);
 }
 
-static void clip_gui_do_mask(GtkWidget *selected_menu_item)
+static void clip_gui_do_mask(ClipboardEntry *selected)
 {
-    if(selected_menu_item == NULL){
+    if(selected == NULL){
         trace("Tried to join with no item selected.\n");
         return;
     }
-    ClipboardEntry *entry = clip_gui_get_entry_copy(selected_menu_item);
-    clip_clipboard_toggle_mask(clipboard, entry);
-    clip_clipboard_entry_free(entry);
+    clip_clipboard_toggle_mask(clipboard, selected);
 }
 
-static void clip_gui_do_join(GtkWidget *selected_menu_item)
+static void clip_gui_do_join(ClipboardEntry *selected)
 {
-    if(selected_menu_item == NULL){
+    if(selected == NULL){
         trace("Tried to join with no item selected.\n");
         return;
     }
-    ClipboardEntry *entry = clip_gui_get_entry_copy(selected_menu_item);
-    clip_clipboard_join(clipboard, entry);
-    clip_clipboard_entry_free(entry);
+    clip_clipboard_join(clipboard, selected);
 }
 
-static void clip_gui_do_change_case(GtkWidget *selected_menu_item, gboolean to_upper)
+static void clip_gui_do_change_case(ClipboardEntry *selected, gboolean to_upper)
 {
-    if(selected_menu_item == NULL){
+    if(selected == NULL){
         trace("Tried to change case with no item selected.\n");
         return;
     }
 
     gboolean (*func)() = to_upper ? clip_clipboard_to_upper : clip_clipboard_to_lower;
-    ClipboardEntry *entry = clip_gui_get_entry_copy(selected_menu_item);
-    func(clipboard, entry);
-    clip_clipboard_entry_free(entry);
+    func(clipboard, selected);
 }
 
-static void clip_gui_trim(GtkWidget *selected_menu_item)
+static void clip_gui_trim(ClipboardEntry *selected)
 {
-    if(selected_menu_item == NULL){
+    if(selected == NULL){
         trace("Tried to trim with no item selected.");
         return;
     }
-    ClipboardEntry *entry = clip_gui_get_entry_copy(selected_menu_item);
-    clip_clipboard_trim(clipboard, entry);
-    clip_clipboard_entry_free(entry);
+    clip_clipboard_trim(clipboard, selected);
 }
 
-static gboolean clip_gui_do_mark(GtkWidget *selected_menu_item, guint keyval)
+static gboolean clip_gui_do_mark(ClipboardEntry *selected, guint keyval)
 {
-    if(selected_menu_item == NULL) { return FALSE; }
+    if(selected == NULL) { return FALSE; }
     if(keyval == GDK_KEY_space || g_unichar_iscntrl(gdk_keyval_to_unicode(keyval))) { return TRUE; }
 
     debug("Entering mark mode. Next letter marks.\n");
-    ClipboardEntry *selected_entry = clip_gui_get_entry_copy(selected_menu_item);
-    clip_clipboard_tag(clipboard, selected_entry, keyval);
-    clip_clipboard_entry_free(selected_entry);
+    clip_clipboard_tag(clipboard, selected, keyval);
     return FALSE;
 }
 
+/**
+ * Activates the entry and pastes it into the window that had focus before the pop-up was shown.
+ */
+static void clip_gui_do_paste(ClipboardEntry *selected)
+{
+    if(selected == NULL){
+        warn("Trying to paste a selected item, but no item is selected.\n");
+        return;
+    }
+    gint64 start_time = g_get_monotonic_time();
+    view->hide();
+    clip_clipboard_set(clipboard, selected, TRUE);
+    clip_paste_send(start_time);
+}
+
 static gboolean clip_gui_activate_mark(guint keyval)
 {
     // Control character may modify the next val. Let it pass through.
     if(keyval == GDK_KEY_space || g_unichar_iscntrl(gdk_keyval_to_unicode(keyval))) { return TRUE; }
-    gint compare(GtkWidget *widget) {
-        Data *data = clip_gui_get_data(widget);
-        if(data == NULL) {
-            return -1;
-        }
-        return !clip_clipboard_entry_has_tag(data->entry, keyval);
-    }
-
     debug("Looking for mark, %c.\n", keyval);
-    GtkWidget *marked = clip_gui_menu_item_find((GCompareFunc)compare);
-    clip_gui_activate_menu_item(marked);
+    view->activate(view->find_tag((char)keyval));
     return FALSE;
 }
 
 static void clip_gui_activate_index(unsigned int index)
 {
-    gint compare(GtkWidget *widget) {
-        Data *data = clip_gui_get_data(widget);
-        if(data == NULL) {
-            return -1;
-        }
-        return data->row != index;
-    }
     debug("Looking for index, %d.\n", index);
-    GtkWidget *nth = clip_gui_menu_item_find((GCompareFunc)compare);
-    clip_gui_activate_menu_item(nth);
+    view->activate(index);
 }
 
 
-static void clip_gui_select_search_match(gboolean reset_on_end)
+/**
+ * Shows the matches found so far. If rank is set, fuzzy matches are shown in ranked order.
+ */
+static void clip_gui_show_search_matches(gboolean rank)
 {
-    if(!clip_gui_search_in_progress() || clip_gui_search_get_length() < 1){ return; }
-    gint compare(GtkWidget *widget) {
-        Data *data = clip_gui_get_data(widget);
-        if(data == NULL || data->row < clip_gui_search_get_position()) {
-            return -1;
-        }
-        const char *text = clip_clipboard_entry_get_text(data->entry);
-        return !g_regex_match_simple(clip_gui_search_get_term(), text, G_REGEX_CASELESS, FALSE);
+    if(rank && clip_gui_search_is_fuzzy()){
+        GArray *ranking = clip_gui_search_get_ranking();
+        view->filter(ranking);
+        g_array_free(ranking, TRUE);
     }
+    view->select(clip_gui_search_get_match());
+}
 
-    GtkWidget *matching = clip_gui_menu_item_find((GCompareFunc)compare);
-    if(matching != NULL) {
-        Data *data = clip_gui_get_data(matching);
-        gtk_menu_shell_select_item(GTK_MENU_SHELL(menu), matching);
-        clip_gui_search_set_position(data->row);
-    } else {
-        gtk_menu_shell_deselect(GTK_MENU_SHELL(menu));
-        clip_gui_search_set_position(0);
-        if(reset_on_end) {
-            clip_gui_select_search_match(FALSE);
+static void clip_gui_cb_search_matches(gboolean done)
+{
+    clip_gui_show_search_matches(TRUE);
+}
+
+/**
+ * Selects the current search match. If the term has changed, its matches are found on a worker thread and shown as
+ * they arrive, so typing is never held up by the search.
+ */
+static void clip_gui_select_search_match(gboolean rank)
+{
+    if(!clip_gui_search_in_progress()){ return; }
+    if(clip_gui_search_get_length() < 1){
+        if(clip_gui_search_is_fuzzy()){
+            view->filter(NULL);
         }
+        return;
+    }
+
+    if(!clip_gui_search_is_complete() && !clip_gui_search_is_running()){
+        // Literal terms are looked up in the history's index, so only the entries containing them are searched.
+        GArray *ids = clip_gui_search_is_literal()
+            ? clip_clipboard_search_ids(clipboard, clip_gui_search_get_term())
+            : NULL;
+        ClipboardHistorySnapshot *rows = view->get_rows();
+        clip_gui_search_find(rows, ids, clip_gui_cb_search_matches);
+        clip_history_snapshot_unref(rows);
+    }
+
+    // Until the first matches arrive, the previous term's stay shown.
+    if(clip_gui_search_is_complete() || clip_gui_search_get_match() >= 0){
+        clip_gui_show_search_matches(rank);
     }
 }
 
+/**
+ * Handles key presses for whichever view is shown.
+ */
 static gboolean clip_gui_cb_keypress(GtkWidget *widget, GdkEvent *event, gpointer data)
 {
     guint keyval = ((GdkEventKey*)event)->keyval;
     gboolean update_required = TRUE;
     gboolean handled = TRUE;
 
-    GtkWidget *selected_menu_item = clip_gui_get_selected_item();
+    ClipboardEntry *selected = view->get_selected();
     if (marking) {
-        marking = clip_gui_do_mark(selected_menu_item, keyval);
+        marking = clip_gui_do_mark(selected, keyval);
 
     } else if (finding) {
         finding = clip_gui_activate_mark(keyval);
         update_required = FALSE;
 
     } else if (clip_gui_search_in_progress()){ 
+        gboolean fuzzy = clip_gui_search_is_fuzzy();
         switch(keyval){
             case GDK_KEY_Escape:
             case GDK_KEY_Down:
@@ -457,19 +608,27 @@ static gboolean clip_gui_cb_keypress(GtkWidget *widget, GdkEvent *event, gpointe
                 clip_gui_search_remove_char();
                 break;
             case GDK_KEY_Tab:
-                clip_gui_search_increment_position();
+                clip_gui_search_next_match();
                 break;
             default:
                 clip_gui_search_append(keyval);
                 break;
         }
-        clip_gui_select_search_match(TRUE);
+        if(clip_gui_search_in_progress()){
+            clip_gui_select_search_match(keyval != GDK_KEY_Tab);
+        } else if(fuzzy){
+            // Leave the selected match selected among all of the rows.
+            view->filter(NULL);
+        }
 
     } else {
         switch(keyval){
             case GUI_SEARCH_LEADER:
                 clip_gui_search_start();
                 break;
+            case GUI_FUZZY_SEARCH_LEADER:
+                clip_gui_search_start_fuzzy();
+                break;
             case GDK_KEY_a:
                 clip_clipboard_next_trim_mode(clipboard);
                 break;
@@ -479,7 +638,7 @@ static gboolean clip_gui_cb_keypress(GtkWidget *widget, GdkEvent *event, gpointe
                 break;
             case GDK_KEY_d:
             case GDK_KEY_Delete:
-                clip_gui_do_delete(selected_menu_item);
+                clip_gui_do_delete(selected);
                 break;
             case GDK_KEY_0: case GDK_KEY_1: case GDK_KEY_2: case GDK_KEY_3: case GDK_KEY_4:
             case GDK_KEY_5: case GDK_KEY_6: case GDK_KEY_7: case GDK_KEY_8: case GDK_KEY_9:
@@ -488,44 +647,51 @@ static gboolean clip_gui_cb_keypress(GtkWidget *widget, GdkEvent *event, gpointe
                 break;
             case GDK_KEY_e:
             case GDK_KEY_E:
-                clip_gui_do_edit(selected_menu_item, keyval == GDK_KEY_E);
+                clip_gui_do_edit(selected, keyval == GDK_KEY_E);
                 update_required = FALSE;
                 break;
             case GDK_KEY_h:
                 clip_clipboard_toggle_history(clipboard);
                 break;
             case GDK_KEY_J:
-                clip_gui_do_join(selected_menu_item);
+                clip_gui_do_join(selected);
                 update_required = FALSE;
                 break;
             case GDK_KEY_L:
-                clip_gui_do_lock(selected_menu_item);
+                clip_gui_do_lock(selected);
                 break;
             case GDK_KEY_u:
             case GDK_KEY_U:
-                clip_gui_do_change_case(selected_menu_item, keyval == GDK_KEY_U);
+                clip_gui_do_change_case(selected, keyval == GDK_KEY_U);
                 break;
             case GDK_KEY_t:
-                clip_gui_trim(selected_menu_item);
+                clip_gui_trim(selected);
                 break;
             case GDK_KEY_m:
                 marking = TRUE;
                 break;
+            case GDK_KEY_p:
+                clip_gui_do_paste(selected);
+                update_required = FALSE;
+                break;
             case GDK_KEY_grave:
                 finding = TRUE;
                 update_required = FALSE;
                 break;
             case GDK_KEY_asterisk:
-                clip_gui_do_mask(selected_menu_item);
+                clip_gui_do_mask(selected);
                 break;
             default:
                 handled = FALSE;
                 break;
         }
     }
+    clip_clipboard_entry_unref(selected);
 
+    // The key's action is complete, so its changes are shown straight away.
+    clip_events_flush();
     if(update_required) {
-        clip_gui_menu_update();
+        view->update();
     }
 
     // If search mode is turned on, drop all subsequent callbacks (like mnemonics).
@@ -536,7 +702,9 @@ static gboolean clip_gui_cb_toggle_lock(GtkWidget *widget, GdkEvent *event, Data
 {
     // Only handle right button press.
     if(((GdkEventButton*)event)->button == 3) {
-        clip_gui_do_lock(widget);
+        ClipboardEntry *entry = clip_gui_get_entry_ref(widget);
+        clip_gui_do_lock(entry);
+        clip_clipboard_entry_unref(entry);
         return TRUE;
     }
     return FALSE;
@@ -548,7 +716,12 @@ static gboolean clip_gui_cb_toggle_lock(GtkWidget *widget, GdkEvent *event, Data
 static gboolean clip_gui_cb_history_activated(GtkMenuItem *widget, Data *data)
 {
     trace("History item activated.\n");
-    clip_clipboard_set(clipboard, data->entry, TRUE);
+    ClipboardEntry *entry = clip_gui_data_get_entry(data);
+    if(entry == NULL){
+        warn("Activated entry is no longer in the history.\n");
+        return FALSE;
+    }
+    clip_clipboard_set(clipboard, entry, TRUE);
     return FALSE;
 }
 
@@ -569,12 +742,105 @@ static gboolean clip_gui_cb_toggle_clipboard(GtkMenuItem *item, Data *data)
 }
 
 /**
- * Triggered by keybinder library.
+ * Delivers a captured key press to the view as if it had been typed into it.
+ */
+static void clip_gui_replay_key(GdkEvent *event)
+{
+    GtkWidget *widget = view->get_widget();
+    if(gtk_widget_get_visible(widget)){
+        event->key.window = g_object_ref(gtk_widget_get_window(widget));
+        gtk_widget_event(widget, event);
+    }
+    gdk_event_free(event);
+}
+
+static void clip_gui_cb_type_ahead(GdkEvent *event, gpointer user_data)
+{
+    if(gtk_widget_get_visible(view->get_widget())){
+        clip_gui_replay_key(event);
+    } else {
+        g_queue_push_tail(type_ahead, event);
+    }
+}
+
+/**
+ * Triggered by keybinder library. Keys typed while the view is being shown are captured, then replayed into it in
+ * order. The keyboard stays grabbed until the view takes it, and keys that were already routed to the root window are
+ * captured until the view is unmapped.
  */
 static void clip_gui_cb_hotkey_handler(const char *keystring, gpointer user_data)
 {
     trace("Global hotkey pressed. Showing dialog.\n");
+    hotkey_time = g_get_monotonic_time();
+    clip_paste_remember_focus();
+    keybinder_capture_keys(clip_gui_cb_type_ahead, NULL);
     clip_gui_show();
+
+    GdkEvent *event = NULL;
+    while((event = g_queue_pop_head(type_ahead)) != NULL){
+        clip_gui_replay_key(event);
+    }
+    if(!gtk_widget_get_visible(view->get_widget())){
+        keybinder_capture_keys(NULL, NULL);
+    }
+}
+
+/**
+ * Activates an entry chosen by a direct key. The entry is looked up in the history, so the pop-up's rows are neither
+ * built nor touched.
+ */
+static void clip_gui_activate_direct(ClipboardEntry *entry)
+{
+    if(entry == NULL){
+        debug("No entry for direct key.\n");
+        return;
+    }
+#if GUI_DIRECT_PASTE
+    gint64 start_time = g_get_monotonic_time();
+    clip_clipboard_set(clipboard, entry, TRUE);
+    clip_paste_remember_focus();
+    clip_paste_send(start_time);
+#else
+    clip_clipboard_set(clipboard, entry, TRUE);
+#endif
+    clip_clipboard_entry_unref(entry);
+}
+
+static void clip_gui_cb_direct_row(const char *keystring, gpointer user_data)
+{
+    trace("Direct row key pressed, %s.\n", keystring);
+    clip_gui_activate_direct(clip_clipboard_get_nth(clipboard, GPOINTER_TO_INT(user_data) - '0'));
+}
+
+static void clip_gui_cb_direct_mark(const char *keystring, gpointer user_data)
+{
+    trace("Direct mark key pressed, %s.\n", keystring);
+    clip_gui_activate_direct(clip_clipboard_get_tagged(clipboard, (char)GPOINTER_TO_INT(user_data)));
+}
+
+/**
+ * Binds, or unbinds, a direct key for each of the characters, formatting the key from the character. The handler is
+ * passed the character.
+ */
+static void clip_gui_bind_direct_keys(const char *format, const char *characters, KeybinderHandler handler,
+        gboolean bind)
+{
+    for(const char *c = characters; *c != '\0'; c++){
+        char *keystring = g_strdup_printf(format, *c);
+        if(bind){
+            keybinder_bind(keystring, handler, GINT_TO_POINTER(*c));
+        } else {
+            keybinder_unbind(keystring, handler);
+        }
+        g_free(keystring);
+    }
+}
+
+static void clip_gui_cb_view_unmapped(GtkWidget *widget, gpointer user_data)
+{
+    keybinder_capture_keys(NULL, NULL);
+    g_queue_free_full(type_ahead, (GDestroyNotify)gdk_event_free);
+    type_ahead = g_queue_new();
 }
 
 /**
@@ -591,25 +857,139 @@ static void clip_gui_cb_trim(GtkWidget *item, gpointer user_data)
     clip_gui_menu_update();
 }
 
-static void clip_gui_do_add_entry(ClipboardEntry *entry, int *row)
+/**
+ * Returns a history row for the entry, reusing a pooled one if there is one. The row's reference is floating, as with
+ * any new widget.
+ */
+static GtkWidget* clip_gui_menu_item_new(int64_t id, guint snapshot_row, ClipboardEntry *entry, int row)
 {
-    Data *data = g_malloc(sizeof(Data));
-    data->entry = clip_clipboard_entry_clone(entry);
-    data->row = (*row)++;
+    Data *data = NULL;
+    GtkWidget *item = g_queue_pop_head(item_pool);
+    if(item != NULL){
+        data = g_object_get_data(G_OBJECT(item), "data");
+        // The pool's reference is handed to the menu.
+        g_object_force_floating(G_OBJECT(item));
+    } else {
+        data = g_malloc0(sizeof(Data));
+        item = gtk_menu_item_new_with_label(NULL);
+        g_object_set_data(G_OBJECT(item),"data", data);
 
-    GtkWidget *item = gtk_menu_item_new_with_label(NULL);
-    g_object_set_data(G_OBJECT(item),"data", data);
-    clip_gui_menu_item_update(item);
+        g_signal_connect(G_OBJECT(item), "button-release-event", G_CALLBACK(clip_gui_cb_toggle_lock), data);
+        g_signal_connect(G_OBJECT(item), "activate", G_CALLBACK(clip_gui_cb_history_activated), data);
 
-    g_signal_connect(G_OBJECT(item), "button-release-event", G_CALLBACK(clip_gui_cb_toggle_lock), data);
-    g_signal_connect(G_OBJECT(item), "activate", G_CALLBACK(clip_gui_cb_history_activated), data);
+        GtkLabel *label = GTK_LABEL(gtk_bin_get_child(GTK_BIN(item)));
+        gtk_label_set_single_line_mode(label, TRUE);
+    }
 
-    GtkLabel *label = GTK_LABEL(gtk_bin_get_child(GTK_BIN(item)));
-    gtk_label_set_single_line_mode(label, TRUE);
+    data->id = id;
+    data->snapshot_row = snapshot_row;
+    data->entry = clip_clipboard_entry_ref(entry);
+    data->row = row;
+    // The key points into the row's data, which outlives the index entry.
+    g_hash_table_insert(id_items, &data->id, item);
+    clip_gui_menu_item_update(item);
+    return item;
+}
 
+static void clip_gui_do_add_row(guint snapshot_row, int *row)
+{
+    int64_t id = clip_history_snapshot_get_id(snapshot, snapshot_row);
+    GtkWidget *item = clip_gui_menu_item_new(id, snapshot_row, NULL, (*row)++);
+    g_ptr_array_add(row_items, item);
     gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
 }
 
+/**
+ * Renumbers the history rows from start up to, but excluding, end after rows have moved. Only rows whose number is
+ * displayed, or was, are rendered again.
+ */
+static void clip_gui_menu_renumber(int start, int end)
+{
+    rows = row_items->len;
+    for(int i = MAX(start, 0); i < MIN(end, rows); i++){
+        GtkWidget *item = g_ptr_array_index(row_items, i);
+        Data *data = clip_gui_get_data(item);
+        int previous = data->row;
+        data->row = i;
+        if(previous != data->row && MIN(previous, data->row) < 10){
+            clip_gui_menu_item_update(item);
+        }
+    }
+}
+
+static void clip_gui_menu_set_empty(gboolean empty)
+{
+    gboolean shown = gtk_widget_get_parent(menu_item_empty) == menu;
+    if(empty && !shown){
+        gtk_menu_shell_insert(GTK_MENU_SHELL(menu), menu_item_empty, GUI_FIRST_ROW_POSITION);
+        gtk_widget_show(menu_item_empty);
+    } else if(!empty && shown){
+        gtk_container_remove(GTK_CONTAINER(menu), menu_item_empty);
+    }
+}
+
+/**
+ * Moves the entry's row to the top of the history, adding a row if the entry isn't shown yet.
+ */
+static void clip_gui_menu_add_entry(ClipboardEntry *entry)
+{
+    clip_gui_menu_set_empty(FALSE);
+
+    GtkWidget *item = clip_gui_menu_item_find_for_entry(entry);
+    int previous = rows;
+    if(item == NULL){
+        item = clip_gui_menu_item_new(clip_clipboard_entry_get_id(entry), 0, entry, 0);
+        gtk_menu_shell_insert(GTK_MENU_SHELL(menu), item, GUI_FIRST_ROW_POSITION);
+        gtk_widget_show(item);
+    } else {
+        previous = clip_gui_get_data(item)->row;
+        g_ptr_array_remove_index(row_items, previous);
+        gtk_menu_reorder_child(GTK_MENU(menu), item, GUI_FIRST_ROW_POSITION);
+        clip_gui_menu_item_change_entry(item, entry);
+    }
+    g_ptr_array_insert(row_items, 0, item);
+    // Only the rows above the entry's previous position move.
+    clip_gui_menu_renumber(0, previous + 1);
+}
+
+static void clip_gui_menu_remove_entry(ClipboardEntry *entry)
+{
+    GtkWidget *item = clip_gui_menu_item_find_for_entry(entry);
+    if(item == NULL){
+        return;
+    }
+    int row = clip_gui_get_data(item)->row;
+    g_ptr_array_remove_index(row_items, row);
+    clip_gui_menu_item_remove(item);
+    clip_gui_menu_renumber(row, rows);
+    clip_gui_menu_set_empty(rows == 0);
+}
+
+
+/**
+ * Moves the shown rows into place after the search item. Rows which aren't shown are hidden rather than removed, so
+ * restoring them is only a matter of moving them back.
+ */
+static void clip_gui_menu_filter(GArray *shown)
+{
+    if(shown == NULL && !filtered){
+        return;
+    }
+
+    for(guint i = 0; i < row_items->len; i++){
+        gtk_widget_set_visible(g_ptr_array_index(row_items, i), shown == NULL);
+    }
+
+    guint length = shown == NULL ? row_items->len : shown->len;
+    for(guint i = 0; i < length; i++){
+        GtkWidget *item = clip_gui_menu_item_find_for_row(shown == NULL ? (int)i : g_array_index(shown, int, i));
+        if(item != NULL){
+            gtk_menu_reorder_child(GTK_MENU(menu), item, GUI_FIRST_ROW_POSITION + i);
+            gtk_widget_show(item);
+        }
+    }
+    filtered = shown != NULL;
+}
 
 /**
  * Updates the menu to contain up-to-date history entries.
@@ -620,17 +1000,23 @@ static void clip_gui_prepare_menu(void)
     clip_gui_search_end();
 
     gtk_container_foreach(GTK_CONTAINER(menu), (GtkCallback)clip_gui_cb_remove_menu_item, NULL);
+    g_ptr_array_set_size(row_items, 0);
     gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_item_search);
     gtk_menu_shell_append(GTK_MENU_SHELL(menu), gtk_separator_menu_item_new());
 
-    GList* history = clip_clipboard_get_history(clipboard);
+    // Rows that were removed above no longer refer to the old snapshot.
+    clip_history_snapshot_unref(snapshot);
+    snapshot = clip_clipboard_get_snapshot(clipboard);
+    clip_gui_view_clear_cache();
     rows = 0;
-    if(history == NULL){
+    guint length = clip_history_snapshot_get_length(snapshot);
+    if(length == 0){
         gtk_menu_shell_append(GTK_MENU_SHELL(menu), menu_item_empty);
     } else {
-        g_list_foreach(history, (GFunc)clip_gui_do_add_entry, &rows);
+        for(guint i = 0; i < length; i++){
+            clip_gui_do_add_row(i, &rows);
+        }
     }
-    clip_clipboard_free_history(history);
     debug("Showing %d entries.\n", rows);
 
     gtk_menu_shell_append(GTK_MENU_SHELL(menu), gtk_separator_menu_item_new());
@@ -644,27 +1030,17 @@ static void clip_gui_prepare_menu(void)
 
     clip_gui_menu_update();
     gtk_widget_show_all(menu);
+    snapshot_current = TRUE;
 }
 
 
-void clip_gui_show(void)
-{
-    trace("Showing history menu.\n");
-    if(menu == NULL){
-        warn("GUI has not yet been initialized!\n");
-        return;
-    }
-    clip_gui_prepare_menu();
-    gtk_menu_popup(GTK_MENU(menu), NULL, NULL, NULL, NULL, 0, gtk_get_current_event_time());
-}
-
-
-static void clip_gui_on_event(ClipboardEvent event, ClipboardEntry* entry)
+static void clip_gui_menu_apply_event(ClipboardEvent event, ClipboardEntry* entry)
 {
+    snapshot_current = FALSE;
     switch(event){
         case CLIPBOARD_REMOVE_EVENT:
             debug("Entry removed.\n");
-            clip_gui_menu_item_remove(clip_gui_menu_item_find_for_entry(entry));
+            clip_gui_menu_remove_entry(entry);
             break;
 
         case CLIPBOARD_UPDATE_EVENT:
@@ -673,23 +1049,221 @@ static void clip_gui_on_event(ClipboardEvent event, ClipboardEntry* entry)
             break;
 
         case CLIPBOARD_ADD_EVENT:
+            debug("Entry added.\n");
+            clip_gui_menu_add_entry(entry);
+            break;
+
         case CLIPBOARD_CLEAR_EVENT:
             debug("Clipboard cleared.\n");
             clip_gui_prepare_menu();
             break;
     }
+}
+
+static void clip_gui_free_event(GuiEvent *pending)
+{
+    clip_clipboard_entry_unref(pending->entry);
+    g_free(pending);
+}
+
+static void clip_gui_menu_flush_events(void)
+{
+    if(prepare_source != 0){
+        g_source_remove(prepare_source);
+        prepare_source = 0;
+    }
+    if(g_queue_is_empty(pending_events)){
+        return;
+    }
+
+    // Rows are numbered in menu order, so the history order is restored first.
+    clip_gui_menu_filter(NULL);
+    GuiEvent *pending = NULL;
+    while((pending = g_queue_pop_head(pending_events)) != NULL){
+        clip_gui_menu_apply_event(pending->event, pending->entry);
+        clip_gui_free_event(pending);
+    }
+    clip_gui_search_invalidate();
+}
+
+static gboolean clip_gui_cb_prepare_menu(gpointer user_data)
+{
+    prepare_source = 0;
+    clip_gui_menu_flush_events();
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * Changes are applied to the menu in idle time while it's hidden, so that it's ready before the hotkey is pressed. While
+ * it's shown, each batch is applied as a whole.
+ */
+static void clip_gui_on_events(GArray *events)
+{
+    for(guint i = 0; i < events->len; i++){
+        ClipboardEventRecord *record = &g_array_index(events, ClipboardEventRecord, i);
+        if(record->event == CLIPBOARD_CLEAR_EVENT){
+            // The menu will be rebuilt, so there's no point applying earlier changes.
+            g_queue_free_full(pending_events, (GDestroyNotify)clip_gui_free_event);
+            pending_events = g_queue_new();
+        }
+
+        GuiEvent *pending = g_malloc(sizeof(GuiEvent));
+        pending->event = record->event;
+        pending->entry = clip_clipboard_entry_ref(record->entry);
+        g_queue_push_tail(pending_events, pending);
+    }
+
+    if(gtk_widget_get_visible(menu)){
+        clip_gui_menu_flush_events();
+    } else if(prepare_source == 0){
+        prepare_source = g_idle_add_full(G_PRIORITY_LOW, clip_gui_cb_prepare_menu, NULL, NULL);
+    }
+}
+
+/**
+ * Resets the menu once it's closed, so showing it again only requires popping it up.
+ */
+static void clip_gui_cb_menu_deactivated(GtkMenuShell *shell, gpointer user_data)
+{
+    clip_gui_search_end();
+    clip_gui_menu_filter(NULL);
+    gtk_menu_shell_deselect(GTK_MENU_SHELL(menu));
+    clip_gui_menu_update();
+}
+
+static void clip_gui_menu_show(void)
+{
+    trace("Showing history menu.\n");
+    // Normally, pending changes have already been applied in idle time.
+    clip_events_flush();
+    clip_gui_menu_flush_events();
+    // The menu takes its own grab straight away.
+    keybinder_release_keyboard();
+    gtk_menu_popup(GTK_MENU(menu), NULL, NULL, NULL, NULL, 0, gtk_get_current_event_time());
+}
+
+static void clip_gui_menu_hide(void)
+{
+    gtk_menu_shell_deactivate(GTK_MENU_SHELL(menu));
+}
+
+static GtkWidget* clip_gui_menu_get_widget(void)
+{
+    return menu;
+}
+
+static ClipboardEntry* clip_gui_menu_get_selected(void)
+{
+    return clip_gui_get_entry_ref(clip_gui_get_selected_item());
+}
+
+static int clip_gui_menu_find(GuiRowPredicate predicate, int start)
+{
+    GuiRow row;
+    for(guint i = MAX(start, 0); i < row_items->len; i++){
+        clip_gui_data_get_row(clip_gui_get_data(g_ptr_array_index(row_items, i)), &row);
+        if(predicate(&row)){
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int clip_gui_menu_find_tag(char tag)
+{
+    Data *data = clip_gui_get_data(g_hash_table_lookup(tag_items, GINT_TO_POINTER(tag)));
+    return data == NULL ? -1 : data->row;
+}
+
+static void clip_gui_menu_select(int row)
+{
+    GtkWidget *item = clip_gui_menu_item_find_for_row(row);
+    if(item == NULL){
+        gtk_menu_shell_deselect(GTK_MENU_SHELL(menu));
+    } else {
+        gtk_menu_shell_select_item(GTK_MENU_SHELL(menu), item);
+    }
+}
+
+static void clip_gui_menu_activate(int row)
+{
+    clip_gui_activate_menu_item(clip_gui_menu_item_find_for_row(row));
+}
+
+/**
+ * Returns the menu's snapshot if no changes have been applied to the rows since it was taken. Otherwise, the rows are
+ * copied into a new one; the menu holds at most HISTORY_MAX_SIZE rows, so the copy is small.
+ */
+static ClipboardHistorySnapshot* clip_gui_menu_get_rows(void)
+{
+    if(snapshot_current){
+        return clip_history_snapshot_ref(snapshot);
+    }
+
+    GuiRow row;
+    gsize text_size = 0;
+    for(guint i = 0; i < row_items->len; i++){
+        text_size += clip_gui_data_get_length(clip_gui_get_data(g_ptr_array_index(row_items, i)));
+    }
+
+    ClipboardHistorySnapshot *copy = clip_history_snapshot_new(row_items->len, text_size);
+    for(guint i = 0; i < row_items->len; i++){
+        clip_gui_data_get_row(clip_gui_get_data(g_ptr_array_index(row_items, i)), &row);
+        clip_history_snapshot_append(copy, row.id, row.text, row.length, row.locked, row.masked, row.tag);
+    }
+    return copy;
+}
 
+static const GuiView menu_view = {
+    clip_gui_menu_get_widget,
+    clip_gui_menu_show,
+    clip_gui_menu_hide,
+    clip_gui_menu_update,
+    clip_gui_menu_get_selected,
+    clip_gui_menu_find,
+    clip_gui_menu_find_tag,
+    clip_gui_menu_select,
+    clip_gui_menu_activate,
+    clip_gui_menu_filter,
+    clip_gui_menu_get_rows,
+};
+
+static gboolean clip_gui_cb_view_mapped(GtkWidget *widget, GdkEvent *event, gpointer user_data)
+{
+    keybinder_release_keyboard();
+    if(hotkey_time != 0){
+        clip_histogram_record(hotkey_latency, g_get_monotonic_time() - hotkey_time);
+        hotkey_time = 0;
+    }
+    return FALSE;
 }
 
+void clip_gui_show(void)
+{
+    if(view == NULL){
+        warn("GUI has not yet been initialized!\n");
+        return;
+    }
+    view->show();
+}
+
+
 void clip_gui_init(Clipboard *_clipboard)
 {
     trace("Creating new GUI menu.\n");
 
-    clip_events_add_observer(clip_gui_on_event);
     clipboard = _clipboard;
 
+    item_pool = g_queue_new();
+    row_items = g_ptr_array_sized_new(HISTORY_MAX_SIZE);
+    id_items = g_hash_table_new(g_int64_hash, g_int64_equal);
+    tag_items = g_hash_table_new(g_direct_hash, g_direct_equal);
+    pending_events = g_queue_new();
+    type_ahead = g_queue_new();
+    hotkey_latency = clip_histogram_new("Hotkey to visible");
     menu = gtk_menu_new();
     g_signal_connect(G_OBJECT(menu), "key-press-event", G_CALLBACK(clip_gui_cb_keypress), NULL);
+    g_signal_connect(G_OBJECT(menu), "deactivate", G_CALLBACK(clip_gui_cb_menu_deactivated), NULL);
 
     menu_item_search = g_object_ref(gtk_menu_item_new_with_label(GUI_SEARCH_MESSAGE));
     gtk_widget_set_sensitive(menu_item_search, FALSE);
@@ -713,17 +1287,36 @@ void clip_gui_init(Clipboard *_clipboard)
 #endif
 
     keybinder_init();
+    clip_paste_init();
     keybinder_bind(GUI_GLOBAL_KEY, clip_gui_cb_hotkey_handler, NULL);
+    clip_gui_bind_direct_keys(GUI_DIRECT_ROW_KEY, GUI_DIRECT_ROWS, clip_gui_cb_direct_row, TRUE);
+    clip_gui_bind_direct_keys(GUI_DIRECT_MARK_KEY, GUI_DIRECT_MARKS, clip_gui_cb_direct_mark, TRUE);
 
-    clip_gui_menu_update();
+#if GUI_VIRTUAL_POPUP
+    view = clip_gui_list_init(clipboard, G_CALLBACK(clip_gui_cb_keypress));
+#else
+    clip_events_add_batch_observer(clip_gui_on_events);
+    clip_gui_prepare_menu();
+    view = &menu_view;
+#endif
+    g_signal_connect(G_OBJECT(view->get_widget()), "map-event", G_CALLBACK(clip_gui_cb_view_mapped), NULL);
+    g_signal_connect(G_OBJECT(view->get_widget()), "unmap", G_CALLBACK(clip_gui_cb_view_unmapped), NULL);
 }
 
 void clip_gui_destroy(void)
 {
     keybinder_unbind(GUI_GLOBAL_KEY, clip_gui_cb_hotkey_handler);
+    clip_gui_bind_direct_keys(GUI_DIRECT_ROW_KEY, GUI_DIRECT_ROWS, clip_gui_cb_direct_row, FALSE);
+    clip_gui_bind_direct_keys(GUI_DIRECT_MARK_KEY, GUI_DIRECT_MARKS, clip_gui_cb_direct_mark, FALSE);
 
-    clip_gui_search_end();
+    clip_gui_search_destroy();
+    clip_gui_editor_destroy();
+    clip_paste_destroy();
 
+#if GUI_VIRTUAL_POPUP
+    clip_gui_list_destroy();
+#endif
+    view = NULL;
     clipboard = NULL;
 
     g_object_unref(menu_item_search);
@@ -754,5 +1347,32 @@ void clip_gui_destroy(void)
 
     gtk_widget_destroy(menu);
     menu = NULL;
+
+    g_queue_free_full(item_pool, (GDestroyNotify)clip_gui_menu_item_free);
+    item_pool = NULL;
+    g_ptr_array_free(row_items, TRUE);
+    row_items = NULL;
+    g_hash_table_destroy(id_items);
+    id_items = NULL;
+    g_hash_table_destroy(tag_items);
+    tag_items = NULL;
+
+    if(prepare_source != 0){
+        g_source_remove(prepare_source);
+        prepare_source = 0;
+    }
+    g_queue_free_full(pending_events, (GDestroyNotify)clip_gui_free_event);
+    pending_events = NULL;
+
+    keybinder_capture_keys(NULL, NULL);
+    g_queue_free_full(type_ahead, (GDestroyNotify)gdk_event_free);
+    type_ahead = NULL;
+
+    clip_histogram_log(hotkey_latency);
+    clip_histogram_free(hotkey_latency);
+    hotkey_latency = NULL;
+
+    clip_history_snapshot_unref(snapshot);
+    snapshot = NULL;
 }
 
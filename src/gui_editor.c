@@ -25,21 +25,162 @@
 
 #include <gtk/gtk.h>
 #include <glib/gi18n.h>
+#include <string.h>
 
-struct widgets {
+/**
+ * Large texts are loaded into the buffer a chunk at a time in idle time, so opening them doesn't freeze the UI. Once
+ * loaded, edits are tracked as the number of characters at the start and end of the text that they haven't touched.
+ * Saving only reads the span between those back out of the buffer.
+ */
+struct editor {
     GtkDialog *dialog;
+    GtkTextView *view;
     GtkTextBuffer *buffer;
+    GuiEditorCallback callback;
+    gpointer user_data;
+    GDestroyNotify notify;
+
+    char *original;
+    gsize length;
+    gsize loaded;
+    guint load_source;
+
+    // Characters at the start and the end of the text that are unedited, or G_MAXINT if nothing has been edited.
+    gint prefix;
+    gint suffix;
 };
 
-static void clip_gui_editor_create_dialog(struct widgets *widgets, char *text)
+// Every editor that's open.
+static GList *editors = NULL;
+
+
+
+static void clip_gui_editor_free(struct editor *editor)
+{
+    editors = g_list_remove(editors, editor);
+    if(editor->load_source != 0){
+        g_source_remove(editor->load_source);
+        editor->load_source = 0;
+    }
+    if(editor->notify != NULL){
+        editor->notify(editor->user_data);
+    }
+    gtk_widget_destroy(GTK_WIDGET(editor->dialog));
+    g_free(editor->original);
+    g_free(editor);
+}
+
+/**
+ * Returns the edited text, or NULL if it's empty or unchanged. The text is the original with the edited span replaced.
+ */
+static char* clip_gui_editor_get_text(struct editor *editor)
 {
-    // Create the textbox and buffer.
+    if(editor->prefix == G_MAXINT){
+        debug("Text wasn't edited. Ignoring edit request.\n");
+        return NULL;
+    }
+
+    gint count = gtk_text_buffer_get_char_count(editor->buffer);
+    if(count == 0){
+        debug("Edited text is empty. Ignoring edit request.\n");
+        return NULL;
+    }
+
+    gint prefix = MIN(editor->prefix, count);
+    gint suffix = MIN(editor->suffix, count - prefix);
+    GtkTextIter start, end;
+    gtk_text_buffer_get_iter_at_offset(editor->buffer, &start, prefix);
+    gtk_text_buffer_get_iter_at_offset(editor->buffer, &end, count - suffix);
+    char *middle = gtk_text_buffer_get_text(editor->buffer, &start, &end, FALSE);
+    gsize middle_length = strlen(middle);
+
+    const char *head_end = g_utf8_offset_to_pointer(editor->original, prefix);
+    const char *tail = g_utf8_offset_to_pointer(editor->original + editor->length, -suffix);
+    char *edited = NULL;
+    if(middle_length == (gsize)(tail - head_end) && memcmp(middle, head_end, middle_length) == 0){
+        debug("Edits left the text unchanged. Ignoring edit request.\n");
+    } else {
+        gsize head_length = head_end - editor->original;
+        gsize tail_length = editor->original + editor->length - tail;
+        edited = g_malloc(head_length + middle_length + tail_length + 1);
+        memcpy(edited, editor->original, head_length);
+        memcpy(edited + head_length, middle, middle_length);
+        memcpy(edited + head_length + middle_length, tail, tail_length);
+        edited[head_length + middle_length + tail_length] = '\0';
+    }
+    g_free(middle);
+    return edited;
+}
+
+static gboolean clip_gui_editor_is_loaded(struct editor *editor)
+{
+    return editor->loaded == editor->length;
+}
+
+static void clip_gui_editor_cb_insert_text(GtkTextBuffer *buffer, GtkTextIter *location, char *text, gint length,
+        struct editor *editor)
+{
+    if(!clip_gui_editor_is_loaded(editor)){
+        return;
+    }
+    gint offset = gtk_text_iter_get_offset(location);
+    editor->prefix = MIN(editor->prefix, offset);
+    editor->suffix = MIN(editor->suffix, gtk_text_buffer_get_char_count(buffer) - offset);
+}
+
+static void clip_gui_editor_cb_delete_range(GtkTextBuffer *buffer, GtkTextIter *start, GtkTextIter *end,
+        struct editor *editor)
+{
+    editor->prefix = MIN(editor->prefix, gtk_text_iter_get_offset(start));
+    editor->suffix = MIN(editor->suffix, gtk_text_buffer_get_char_count(buffer) - gtk_text_iter_get_offset(end));
+}
+
+/**
+ * Loads the next chunk of the text into the buffer. The text can't be edited, or saved, until it's all loaded.
+ */
+static gboolean clip_gui_editor_cb_load(struct editor *editor)
+{
+    gsize end = MIN(editor->loaded + GUI_EDITOR_LOAD_CHUNK_SIZE, editor->length);
+    // Don't split a character across chunks.
+    while(end > editor->loaded && end < editor->length && (editor->original[end] & 0xc0) == 0x80){
+        end--;
+    }
+
+    GtkTextIter iter;
+    gtk_text_buffer_get_end_iter(editor->buffer, &iter);
+    gsize start = editor->loaded;
+    // Only the last chunk's insertion counts as loaded, so none of them are tracked as edits.
+    gtk_text_buffer_insert(editor->buffer, &iter, editor->original + start, end - start);
+    editor->loaded = end;
+    if(!clip_gui_editor_is_loaded(editor)){
+        return G_SOURCE_CONTINUE;
+    }
+
+    trace("Loaded %"G_GSIZE_FORMAT" bytes into editor.\n", editor->length);
+    editor->load_source = 0;
+    gtk_text_buffer_get_start_iter(editor->buffer, &iter);
+    gtk_text_buffer_place_cursor(editor->buffer, &iter);
+    gtk_text_view_set_editable(editor->view, TRUE);
+    gtk_dialog_set_response_sensitive(editor->dialog, GTK_RESPONSE_ACCEPT, TRUE);
+    return G_SOURCE_REMOVE;
+}
+
+static void clip_gui_editor_cb_response(GtkDialog *dialog, gint response, struct editor *editor)
+{
+    char *edited = response == GTK_RESPONSE_ACCEPT ? clip_gui_editor_get_text(editor) : NULL;
+    editor->callback(edited, editor->user_data);
+    clip_gui_editor_free(editor);
+}
+
+static void clip_gui_editor_create_dialog(struct editor *editor, const char *text)
+{
+    // Create the textbox and buffer. The text is loaded later.
     GtkWidget *textbox = gtk_text_view_new();
     GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(textbox));
-    gtk_text_buffer_set_text(buffer, text == NULL ? "" : text, -1);
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(textbox), FALSE);
 
-    // Set-up the dialog box.
-    GtkWidget *dialog = gtk_dialog_new_with_buttons(PROGRAM, NULL, GTK_DIALOG_MODAL,
+    // Set-up the dialog box. It isn't modal, so the pop-up and other editors keep working while it's open.
+    GtkWidget *dialog = gtk_dialog_new_with_buttons(PROGRAM, NULL, 0,
             _("OK"), GTK_RESPONSE_ACCEPT,
             _("CANCEL"), GTK_RESPONSE_REJECT,
             NULL);
@@ -50,36 +191,47 @@ static void clip_gui_editor_create_dialog(struct widgets *widgets, char *text)
     GtkWidget *content = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
     gtk_box_pack_start(GTK_BOX(content), textbox, TRUE, TRUE, 0);
 
+    gtk_dialog_set_response_sensitive(GTK_DIALOG(dialog), GTK_RESPONSE_ACCEPT, FALSE);
+
     // Populate.
-    widgets->dialog = (GtkDialog*)dialog;
-    widgets->buffer = buffer;
+    editor->dialog = (GtkDialog*)dialog;
+    editor->view = GTK_TEXT_VIEW(textbox);
+    editor->buffer = buffer;
+    editor->original = g_strdup(text == NULL ? "" : text);
+    editor->length = strlen(editor->original);
+    editor->prefix = G_MAXINT;
+    editor->suffix = G_MAXINT;
+    g_signal_connect(G_OBJECT(buffer), "insert-text", G_CALLBACK(clip_gui_editor_cb_insert_text), editor);
+    g_signal_connect(G_OBJECT(buffer), "delete-range", G_CALLBACK(clip_gui_editor_cb_delete_range), editor);
 }
 
 
-char* clip_gui_editor_edit_text(char *text)
+void clip_gui_editor_edit_text(const char *text, GuiEditorCallback callback, gpointer user_data, GDestroyNotify notify)
 {
-    struct widgets ui = {0};
-    clip_gui_editor_create_dialog(&ui, text);
-
-    gtk_widget_show_all(GTK_WIDGET(ui.dialog));
-    gint result = gtk_dialog_run(ui.dialog);
+    struct editor *editor = g_malloc0(sizeof(struct editor));
+    editor->callback = callback;
+    editor->user_data = user_data;
+    editor->notify = notify;
+    clip_gui_editor_create_dialog(editor, text);
+    editors = g_list_prepend(editors, editor);
 
-    char *edited = NULL;
-    if(result == GTK_RESPONSE_ACCEPT){
-        GtkTextIter start, end;
-        gtk_text_buffer_get_bounds(ui.buffer, &start, &end);
-        if(gtk_text_iter_get_offset(&end) > 0){
-            edited = gtk_text_buffer_get_text(ui.buffer, &start, &end, FALSE);
-        } else {
-            debug("Edited text is empty. Ignoring edit request.\n");
-        }
+    g_signal_connect(G_OBJECT(editor->dialog), "response", G_CALLBACK(clip_gui_editor_cb_response), editor);
+    // Small texts are loaded straight away; only a large one is shown while it loads.
+    if(clip_gui_editor_cb_load(editor)){
+        editor->load_source = g_idle_add((GSourceFunc)clip_gui_editor_cb_load, editor);
     }
-
-    gtk_widget_destroy(GTK_WIDGET(ui.dialog));
-    return edited;
+    gtk_widget_show_all(GTK_WIDGET(editor->dialog));
+    gtk_window_present(GTK_WINDOW(editor->dialog));
 }
 
 void clip_gui_editor_free_text(char *text)
 {
     g_free(text);
 }
+
+void clip_gui_editor_destroy(void)
+{
+    while(editors != NULL){
+        clip_gui_editor_free(editors->data);
+    }
+}
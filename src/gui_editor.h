@@ -19,5 +19,25 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
-char* clip_gui_editor_edit_text(char *text);
+#include <glib.h>
+
+#ifndef __CLIP_GUI_EDITOR_TYPES__
+#define __CLIP_GUI_EDITOR_TYPES__
+/**
+ * Called when an editor is closed. edited is the new text, or NULL if the edit was cancelled or left the text empty or
+ * unchanged.
+ * The text must be released with clip_gui_editor_free_text.
+ */
+typedef void (*GuiEditorCallback)(char *edited, gpointer user_data);
+#endif
+
+/**
+ * Opens an editor window for the text and returns straight away. The callback is called once the window is closed,
+ * after which notify, if given, is called with user_data. Any number of editors may be open at once.
+ */
+void clip_gui_editor_edit_text(const char *text, GuiEditorCallback callback, gpointer user_data, GDestroyNotify notify);
 void clip_gui_editor_free_text(char *text);
+/**
+ * Closes every open editor without calling its callback.
+ */
+void clip_gui_editor_destroy(void);
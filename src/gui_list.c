@@ -0,0 +1,800 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "gui_list.h"
+#include "gui_search.h"
+#include "history_snapshot.h"
+
+#include "config.h"
+#include "clipboard_events.h"
+#include "utils.h"
+
+#include <gtk/gtk.h>
+#include <string.h>
+
+/**
+ * A list model over the history rows. Rows are produced from the rows on demand, so the tree view only formats the rows
+ * that are visible.
+ * <br />
+ * A filtered model only lists some of the rows, in the given order. Positions in the list are mapped to rows, and back,
+ * through order and positions.
+ */
+typedef struct {
+    GObject parent;
+    gint stamp;
+    GArray *order;
+    GArray *positions;
+} HistoryModel;
+
+typedef struct {
+    GObjectClass parent_class;
+} HistoryModelClass;
+
+static void clip_history_model_tree_model_init(GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(HistoryModel, clip_history_model, G_TYPE_OBJECT,
+        G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL, clip_history_model_tree_model_init))
+
+#define CLIP_HISTORY_MODEL(object) (G_TYPE_CHECK_INSTANCE_CAST((object), clip_history_model_get_type(), HistoryModel))
+
+// Not owned.
+static Clipboard *clipboard = NULL;
+
+/**
+ * Rows are read from the snapshot until the history changes. Changes are then applied to the rows, with the live entry
+ * standing in for the snapshot's copy, rather than taking a new snapshot.
+ */
+typedef struct {
+    int64_t id;
+    guint snapshot_row;
+    ClipboardEntry *entry;
+} ListRow;
+
+// Owned.
+static GtkWidget *window = NULL;
+static GtkWidget *status = NULL;
+static GtkWidget *tree = NULL;
+static HistoryModel *model = NULL;
+static ClipboardHistorySnapshot *snapshot = NULL;
+// The history rows, oldest first, so that a new row is added at the end. Row i of the list is at len - 1 - i.
+static GArray *list_rows = NULL;
+// The slot of each id's row. A slot is the row's place in list_rows plus list_base, so that removing a row only has to
+// renumber the rows on its shorter side: eviction removes old rows and promotion removes new ones.
+static GHashTable *list_slots = NULL;
+static guint list_base = 0;
+// Set while the rows are exactly the snapshot's rows.
+static gboolean snapshot_current = FALSE;
+
+
+
+static void clip_history_model_init(HistoryModel *self)
+{
+    self->stamp = g_random_int();
+    self->order = NULL;
+    self->positions = NULL;
+}
+
+static void clip_history_model_finalize(GObject *object)
+{
+    HistoryModel *self = CLIP_HISTORY_MODEL(object);
+    if(self->order != NULL){
+        g_array_free(self->order, TRUE);
+        g_array_free(self->positions, TRUE);
+        self->order = NULL;
+        self->positions = NULL;
+    }
+    G_OBJECT_CLASS(clip_history_model_parent_class)->finalize(object);
+}
+
+static void clip_history_model_class_init(HistoryModelClass *klass)
+{
+    G_OBJECT_CLASS(klass)->finalize = clip_history_model_finalize;
+}
+
+/**
+ * Creates a model listing every row.
+ */
+static HistoryModel* clip_history_model_new(void)
+{
+    return g_object_new(clip_history_model_get_type(), NULL);
+}
+
+/**
+ * Creates a model listing only the given rows, in order.
+ */
+static HistoryModel* clip_history_model_new_filtered(GArray *rows)
+{
+    HistoryModel *self = clip_history_model_new();
+    guint length = list_rows->len;
+    self->order = g_array_sized_new(FALSE, FALSE, sizeof(int), rows->len);
+    self->positions = g_array_sized_new(FALSE, FALSE, sizeof(int), length);
+    g_array_set_size(self->positions, length);
+    memset(self->positions->data, 0xff, length * sizeof(int));
+
+    for(guint i = 0; i < rows->len; i++){
+        int row = g_array_index(rows, int, i);
+        if(row >= 0 && row < (int)length){
+            g_array_index(self->positions, int, row) = self->order->len;
+            g_array_append_val(self->order, row);
+        }
+    }
+    return self;
+}
+
+/**
+ * Returns the number of rows listed.
+ */
+static gint clip_history_model_get_length(HistoryModel *self)
+{
+    return self->order == NULL ? (gint)list_rows->len : (gint)self->order->len;
+}
+
+/**
+ * Returns the row listed at the position.
+ */
+static int clip_history_model_get_row(HistoryModel *self, int position)
+{
+    return self->order == NULL ? position : g_array_index(self->order, int, position);
+}
+
+/**
+ * Returns the position the row is listed at, or -1 if it isn't listed.
+ */
+static int clip_history_model_get_position(HistoryModel *self, int row)
+{
+    if(row < 0 || row >= (int)list_rows->len){
+        return -1;
+    }
+    return self->order == NULL ? row : g_array_index(self->positions, int, row);
+}
+
+static gboolean clip_history_model_set_iter(HistoryModel *self, GtkTreeIter *iter, gint row)
+{
+    if(row < 0 || row >= clip_history_model_get_length(self)){
+        iter->stamp = 0;
+        return FALSE;
+    }
+    iter->stamp = self->stamp;
+    iter->user_data = GINT_TO_POINTER(row);
+    return TRUE;
+}
+
+static GtkTreeModelFlags clip_history_model_get_flags(GtkTreeModel *tree_model)
+{
+    // Iterators are positions, so they don't survive rows being added or removed.
+    return GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint clip_history_model_get_n_columns(GtkTreeModel *tree_model)
+{
+    return 1;
+}
+
+static GType clip_history_model_get_column_type(GtkTreeModel *tree_model, gint index)
+{
+    return G_TYPE_INT;
+}
+
+static gboolean clip_history_model_get_iter(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreePath *path)
+{
+    if(gtk_tree_path_get_depth(path) != 1){
+        return FALSE;
+    }
+    return clip_history_model_set_iter(CLIP_HISTORY_MODEL(tree_model), iter, gtk_tree_path_get_indices(path)[0]);
+}
+
+static GtkTreePath* clip_history_model_get_path(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+    return gtk_tree_path_new_from_indices(GPOINTER_TO_INT(iter->user_data), -1);
+}
+
+static void clip_history_model_get_value(GtkTreeModel *tree_model, GtkTreeIter *iter, gint column, GValue *value)
+{
+    g_value_init(value, G_TYPE_INT);
+    g_value_set_int(value, GPOINTER_TO_INT(iter->user_data));
+}
+
+static gboolean clip_history_model_iter_next(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+    return clip_history_model_set_iter(CLIP_HISTORY_MODEL(tree_model), iter, GPOINTER_TO_INT(iter->user_data) + 1);
+}
+
+static gboolean clip_history_model_iter_children(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent)
+{
+    if(parent != NULL){
+        return FALSE;
+    }
+    return clip_history_model_set_iter(CLIP_HISTORY_MODEL(tree_model), iter, 0);
+}
+
+static gboolean clip_history_model_iter_has_child(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+    return FALSE;
+}
+
+static gint clip_history_model_iter_n_children(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+    return iter == NULL ? clip_history_model_get_length(CLIP_HISTORY_MODEL(tree_model)) : 0;
+}
+
+static gboolean clip_history_model_iter_nth_child(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent, gint n)
+{
+    if(parent != NULL){
+        return FALSE;
+    }
+    return clip_history_model_set_iter(CLIP_HISTORY_MODEL(tree_model), iter, n);
+}
+
+static gboolean clip_history_model_iter_parent(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *child)
+{
+    return FALSE;
+}
+
+static void clip_history_model_tree_model_init(GtkTreeModelIface *iface)
+{
+    iface->get_flags = clip_history_model_get_flags;
+    iface->get_n_columns = clip_history_model_get_n_columns;
+    iface->get_column_type = clip_history_model_get_column_type;
+    iface->get_iter = clip_history_model_get_iter;
+    iface->get_path = clip_history_model_get_path;
+    iface->get_value = clip_history_model_get_value;
+    iface->iter_next = clip_history_model_iter_next;
+    iface->iter_children = clip_history_model_iter_children;
+    iface->iter_has_child = clip_history_model_iter_has_child;
+    iface->iter_n_children = clip_history_model_iter_n_children;
+    iface->iter_nth_child = clip_history_model_iter_nth_child;
+    iface->iter_parent = clip_history_model_iter_parent;
+}
+
+
+
+static ListRow* clip_gui_list_row_at(int row)
+{
+    return &g_array_index(list_rows, ListRow, list_rows->len - 1 - row);
+}
+
+static void clip_gui_list_get_row(int index, GuiRow *row)
+{
+    ListRow *list_row = clip_gui_list_row_at(index);
+    ClipboardEntry *entry = list_row->entry;
+    guint snapshot_row = list_row->snapshot_row;
+    row->row = index;
+    row->id = list_row->id;
+    row->version = clip_clipboard_entry_get_version(entry);
+    if(entry != NULL){
+        row->text = clip_clipboard_entry_get_text(entry);
+        row->length = clip_clipboard_entry_get_length(entry);
+        row->locked = clip_clipboard_entry_get_locked(entry);
+        row->masked = clip_clipboard_entry_is_masked(entry);
+        row->tag = clip_clipboard_entry_get_tag(entry);
+    } else {
+        row->text = clip_history_snapshot_get_text(snapshot, snapshot_row);
+        row->length = clip_history_snapshot_get_text_length(snapshot, snapshot_row);
+        row->locked = clip_history_snapshot_is_locked(snapshot, snapshot_row);
+        row->masked = clip_history_snapshot_is_masked(snapshot, snapshot_row);
+        row->tag = clip_history_snapshot_get_tag(snapshot, snapshot_row);
+    }
+}
+
+static ClipboardEntry* clip_gui_list_get_entry(int row)
+{
+    if(row < 0 || row >= (int)list_rows->len){
+        return NULL;
+    }
+    ListRow *list_row = clip_gui_list_row_at(row);
+    if(list_row->entry != NULL){
+        return clip_clipboard_entry_ref(list_row->entry);
+    }
+    return clip_clipboard_get_entry(clipboard, list_row->id);
+}
+
+/**
+ * Returns the row holding the id, or -1 if there isn't one.
+ */
+static int clip_gui_list_find_id(int64_t id)
+{
+    gpointer slot = NULL;
+    if(!g_hash_table_lookup_extended(list_slots, &id, NULL, &slot)){
+        return -1;
+    }
+    return list_rows->len - 1 - (GPOINTER_TO_UINT(slot) - list_base);
+}
+
+/**
+ * Indexes the row at the place in list_rows under its id.
+ */
+static void clip_gui_list_index_slot(guint place)
+{
+    int64_t *id = g_new(int64_t, 1);
+    *id = g_array_index(list_rows, ListRow, place).id;
+    g_hash_table_replace(list_slots, id, GUINT_TO_POINTER(place + list_base));
+}
+
+static int clip_gui_list_get_cursor(void)
+{
+    GtkTreeIter iter;
+    GtkTreeSelection *selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(tree));
+    if(!gtk_tree_selection_get_selected(selection, NULL, &iter)){
+        return -1;
+    }
+    return clip_history_model_get_row(model, GPOINTER_TO_INT(iter.user_data));
+}
+
+static void clip_gui_list_select(int row)
+{
+    int position = clip_history_model_get_position(model, row);
+    if(position < 0){
+        gtk_tree_selection_unselect_all(gtk_tree_view_get_selection(GTK_TREE_VIEW(tree)));
+        return;
+    }
+    GtkTreePath *path = gtk_tree_path_new_from_indices(position, -1);
+    gtk_tree_view_set_cursor(GTK_TREE_VIEW(tree), path, NULL, FALSE);
+    gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(tree), path, NULL, FALSE, 0, 0);
+    gtk_tree_path_free(path);
+}
+
+static void clip_gui_list_clear_rows(void)
+{
+    for(guint i = 0; i < list_rows->len; i++){
+        clip_clipboard_entry_unref(g_array_index(list_rows, ListRow, i).entry);
+    }
+    g_array_set_size(list_rows, 0);
+    g_hash_table_remove_all(list_slots);
+    list_base = 0;
+}
+
+/**
+ * Replaces the rows with those of a new snapshot, keeping the selected entry selected. This is only needed when the
+ * list is created or the history is cleared; other changes are applied to the rows.
+ */
+static void clip_gui_list_refresh(void)
+{
+    int64_t selected_id = 0;
+    int cursor = model == NULL ? -1 : clip_gui_list_get_cursor();
+    if(cursor >= 0){
+        selected_id = clip_gui_list_row_at(cursor)->id;
+    }
+
+    HistoryModel *previous = model;
+    // The view lets go of the old model before its rows are replaced.
+    gtk_tree_view_set_model(GTK_TREE_VIEW(tree), NULL);
+    clip_gui_list_clear_rows();
+    clip_history_snapshot_unref(snapshot);
+    snapshot = clip_clipboard_get_snapshot(clipboard);
+    guint length = clip_history_snapshot_get_length(snapshot);
+    for(guint i = length; i > 0; i--){
+        ListRow row = { clip_history_snapshot_get_id(snapshot, i - 1), i - 1, NULL };
+        g_array_append_val(list_rows, row);
+        clip_gui_list_index_slot(list_rows->len - 1);
+    }
+    snapshot_current = TRUE;
+
+    model = clip_history_model_new();
+    clip_gui_view_clear_cache();
+    clip_gui_search_invalidate();
+    gtk_tree_view_set_model(GTK_TREE_VIEW(tree), GTK_TREE_MODEL(model));
+    if(previous != NULL){
+        g_object_unref(previous);
+    }
+
+    if(selected_id != 0){
+        clip_gui_list_select(clip_gui_list_find_id(selected_id));
+    }
+    debug("Listing %d entries.\n", clip_history_model_get_length(model));
+}
+
+static void clip_gui_list_remove_row(int row)
+{
+    guint place = list_rows->len - 1 - row;
+    ListRow *list_row = &g_array_index(list_rows, ListRow, place);
+    g_hash_table_remove(list_slots, &list_row->id);
+    clip_clipboard_entry_unref(list_row->entry);
+    g_array_remove_index(list_rows, place);
+    if(place < list_rows->len - place){
+        // Moving the base moves every row down a place, which is right for the newer rows, so only the older ones are
+        // renumbered.
+        list_base++;
+        for(guint i = 0; i < place; i++){
+            clip_gui_list_index_slot(i);
+        }
+    } else {
+        for(guint i = place; i < list_rows->len; i++){
+            clip_gui_list_index_slot(i);
+        }
+    }
+
+    GtkTreePath *path = gtk_tree_path_new_from_indices(row, -1);
+    gtk_tree_model_row_deleted(GTK_TREE_MODEL(model), path);
+    gtk_tree_path_free(path);
+}
+
+/**
+ * Moves the entry's row to the top of the history, adding a row if the entry isn't listed yet.
+ */
+static void clip_gui_list_add_entry(ClipboardEntry *entry)
+{
+    int64_t id = clip_clipboard_entry_get_id(entry);
+    int previous = clip_gui_list_find_id(id);
+    if(previous >= 0){
+        clip_gui_list_remove_row(previous);
+    }
+
+    GtkTreeIter iter;
+    ListRow row = { id, 0, clip_clipboard_entry_ref(entry) };
+    g_array_append_val(list_rows, row);
+    clip_gui_list_index_slot(list_rows->len - 1);
+    GtkTreePath *path = gtk_tree_path_new_first();
+    clip_history_model_set_iter(model, &iter, 0);
+    gtk_tree_model_row_inserted(GTK_TREE_MODEL(model), path, &iter);
+    gtk_tree_path_free(path);
+}
+
+static void clip_gui_list_remove_entry(ClipboardEntry *entry)
+{
+    int row = clip_gui_list_find_id(clip_clipboard_entry_get_id(entry));
+    if(row >= 0){
+        clip_gui_list_remove_row(row);
+    }
+}
+
+static void clip_gui_list_update_entry(ClipboardEntry *entry)
+{
+    int row = clip_gui_list_find_id(clip_clipboard_entry_get_id(entry));
+    if(row < 0){
+        return;
+    }
+
+    GtkTreeIter iter;
+    ListRow *list_row = clip_gui_list_row_at(row);
+    if(list_row->entry != entry){
+        clip_clipboard_entry_unref(list_row->entry);
+        list_row->entry = clip_clipboard_entry_ref(entry);
+    }
+    GtkTreePath *path = gtk_tree_path_new_from_indices(row, -1);
+    clip_history_model_set_iter(model, &iter, row);
+    gtk_tree_model_row_changed(GTK_TREE_MODEL(model), path, &iter);
+    gtk_tree_path_free(path);
+}
+
+static void clip_gui_list_apply_event(ClipboardEvent event, ClipboardEntry *entry)
+{
+    snapshot_current = FALSE;
+    switch(event){
+        case CLIPBOARD_REMOVE_EVENT:
+            debug("Entry removed.\n");
+            clip_gui_list_remove_entry(entry);
+            break;
+
+        case CLIPBOARD_UPDATE_EVENT:
+            debug("Entry updated.\n");
+            clip_gui_list_update_entry(entry);
+            break;
+
+        case CLIPBOARD_ADD_EVENT:
+            debug("Entry added.\n");
+            clip_gui_list_add_entry(entry);
+            break;
+
+        case CLIPBOARD_CLEAR_EVENT:
+            debug("Clipboard cleared.\n");
+            clip_gui_list_refresh();
+            break;
+    }
+}
+
+static void clip_gui_list_update(void)
+{
+    char *markedup = NULL;
+    if(clip_gui_search_in_progress()){
+        markedup = g_markup_printf_escaped("<i><b>%s</b></i>", clip_gui_search_get_term());
+    } else {
+        markedup = g_markup_printf_escaped("<i>%s</i>   %s   %s",
+                list_rows->len == 0 ? GUI_EMPTY_MESSAGE : GUI_SEARCH_MESSAGE,
+                clip_gui_view_trim_label(clip_clipboard_get_trim_mode(clipboard)),
+                clip_clipboard_is_enabled(clipboard) ? "" : "(History Disabled)");
+    }
+    gtk_label_set_markup(GTK_LABEL(status), markedup);
+    g_free(markedup);
+}
+
+static void clip_gui_list_show(void)
+{
+    trace("Showing history list.\n");
+    clip_gui_search_end();
+
+    // Changes are applied to the rows as they happen, so showing the list doesn't depend on its size.
+    clip_events_flush();
+
+    clip_gui_list_select(-1);
+    gtk_tree_view_scroll_to_point(GTK_TREE_VIEW(tree), 0, 0);
+    clip_gui_list_update();
+    gtk_widget_show_all(window);
+    gtk_window_present_with_time(GTK_WINDOW(window), gtk_get_current_event_time());
+    gtk_widget_grab_focus(tree);
+}
+
+/**
+ * Swaps in a model listing only the given rows, keeping the selected row selected if it's still listed.
+ */
+static void clip_gui_list_filter(GArray *rows)
+{
+    if(rows == NULL && model->order == NULL){
+        return;
+    }
+
+    int selected = clip_gui_list_get_cursor();
+    HistoryModel *previous = model;
+    model = rows == NULL ? clip_history_model_new() : clip_history_model_new_filtered(rows);
+    gtk_tree_view_set_model(GTK_TREE_VIEW(tree), GTK_TREE_MODEL(model));
+    g_object_unref(previous);
+    clip_gui_list_select(selected);
+}
+
+static void clip_gui_list_hide(void)
+{
+    gtk_widget_hide(window);
+    clip_gui_list_filter(NULL);
+}
+
+static GtkWidget* clip_gui_list_get_widget(void)
+{
+    return window;
+}
+
+static ClipboardEntry* clip_gui_list_get_selected(void)
+{
+    return clip_gui_list_get_entry(clip_gui_list_get_cursor());
+}
+
+static int clip_gui_list_find(GuiRowPredicate predicate, int start)
+{
+    GuiRow row;
+    for(int i = MAX(start, 0); i < (int)list_rows->len; i++){
+        clip_gui_list_get_row(i, &row);
+        if(predicate(&row)){
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int clip_gui_list_find_tag(char tag)
+{
+    if(snapshot_current){
+        return clip_history_snapshot_find_tag(snapshot, tag);
+    }
+
+    GuiRow row;
+    for(guint i = 0; tag != 0 && i < list_rows->len; i++){
+        clip_gui_list_get_row(i, &row);
+        if(row.tag == tag){
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void clip_gui_list_activate(int row)
+{
+    ClipboardEntry *entry = clip_gui_list_get_entry(row);
+    if(entry == NULL){
+        debug("No row to activate.\n");
+        return;
+    }
+    clip_gui_list_hide();
+    clip_clipboard_set(clipboard, entry, TRUE);
+    clip_clipboard_entry_unref(entry);
+}
+
+/**
+ * Returns the list's snapshot if no changes have been applied to the rows since it was taken. Otherwise, the rows are
+ * copied into a new one, which becomes the list's snapshot. So the rows are copied at most once per change, when a search
+ * starts, and not on every keystroke.
+ */
+static ClipboardHistorySnapshot* clip_gui_list_get_rows(void)
+{
+    if(snapshot_current){
+        return clip_history_snapshot_ref(snapshot);
+    }
+
+    GuiRow row;
+    gsize text_size = 0;
+    for(guint i = 0; i < list_rows->len; i++){
+        clip_gui_list_get_row(i, &row);
+        text_size += row.length;
+    }
+
+    ClipboardHistorySnapshot *copy = clip_history_snapshot_new(list_rows->len, text_size);
+    for(guint i = 0; i < list_rows->len; i++){
+        clip_gui_list_get_row(i, &row);
+        clip_history_snapshot_append(copy, row.id, row.text, row.length, row.locked, row.masked, row.tag);
+    }
+
+    // Rows now read from the copy, so the live entries they held can be released.
+    for(guint i = 0; i < list_rows->len; i++){
+        ListRow *list_row = clip_gui_list_row_at(i);
+        clip_clipboard_entry_unref(list_row->entry);
+        list_row->entry = NULL;
+        list_row->snapshot_row = i;
+    }
+    clip_history_snapshot_unref(snapshot);
+    snapshot = copy;
+    snapshot_current = TRUE;
+    // Rendered rows are keyed by entry version, which the rows no longer have.
+    clip_gui_view_clear_cache();
+    return clip_history_snapshot_ref(snapshot);
+}
+
+static const GuiView list_view = {
+    clip_gui_list_get_widget,
+    clip_gui_list_show,
+    clip_gui_list_hide,
+    clip_gui_list_update,
+    clip_gui_list_get_selected,
+    clip_gui_list_find,
+    clip_gui_list_find_tag,
+    clip_gui_list_select,
+    clip_gui_list_activate,
+    clip_gui_list_filter,
+    clip_gui_list_get_rows,
+};
+
+
+
+static void clip_gui_list_cb_render_row(GtkTreeViewColumn *column, GtkCellRenderer *renderer, GtkTreeModel *tree_model,
+        GtkTreeIter *iter, gpointer data)
+{
+    GuiRow row;
+    int index = clip_history_model_get_row(CLIP_HISTORY_MODEL(tree_model), GPOINTER_TO_INT(iter->user_data));
+    clip_gui_list_get_row(index, &row);
+    g_object_set(renderer, "markup", clip_gui_view_render_row(clipboard, &row), NULL);
+}
+
+static void clip_gui_list_cb_row_activated(GtkTreeView *view, GtkTreePath *path, GtkTreeViewColumn *column, gpointer data)
+{
+    trace("History row activated.\n");
+    clip_gui_list_activate(clip_history_model_get_row(model, gtk_tree_path_get_indices(path)[0]));
+}
+
+/**
+ * Only receives the keys which neither the key handler nor the list consumed.
+ */
+static gboolean clip_gui_list_cb_keypress(GtkWidget *widget, GdkEvent *event, gpointer data)
+{
+    if(((GdkEventKey*)event)->keyval == GDK_KEY_Escape){
+        clip_gui_list_hide();
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static gboolean clip_gui_list_cb_toggle_lock(GtkWidget *widget, GdkEvent *event, gpointer data)
+{
+    GdkEventButton *button = (GdkEventButton*)event;
+    GtkTreePath *path = NULL;
+    // Only handle right button press.
+    if(button->button != 3 || !gtk_tree_view_get_path_at_pos(GTK_TREE_VIEW(tree), button->x, button->y, &path, NULL, NULL, NULL)){
+        return FALSE;
+    }
+    ClipboardEntry *entry = clip_gui_list_get_entry(clip_history_model_get_row(model, gtk_tree_path_get_indices(path)[0]));
+    if(entry != NULL){
+        clip_clipboard_toggle_lock(clipboard, entry);
+    }
+    clip_clipboard_entry_unref(entry);
+    gtk_tree_path_free(path);
+    return TRUE;
+}
+
+static gboolean clip_gui_list_cb_focus_out(GtkWidget *widget, GdkEvent *event, gpointer data)
+{
+    clip_gui_list_hide();
+    return FALSE;
+}
+
+/**
+ * Changes are applied to the rows in place, so the view only redraws the rows that moved or changed.
+ */
+static void clip_gui_list_on_events(GArray *events)
+{
+    // Rows are numbered in history order, so the history order is restored first.
+    clip_gui_list_filter(NULL);
+    for(guint i = 0; i < events->len; i++){
+        ClipboardEventRecord *record = &g_array_index(events, ClipboardEventRecord, i);
+        clip_gui_list_apply_event(record->event, record->entry);
+    }
+    clip_gui_search_invalidate();
+    if(gtk_widget_get_visible(window)){
+        clip_gui_list_update();
+    }
+}
+
+const GuiView* clip_gui_list_init(Clipboard *_clipboard, GCallback on_keypress)
+{
+    trace("Creating new GUI list.\n");
+    clipboard = _clipboard;
+
+    window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(window), PROGRAM);
+    gtk_window_set_decorated(GTK_WINDOW(window), FALSE);
+    gtk_window_set_keep_above(GTK_WINDOW(window), TRUE);
+    gtk_window_set_skip_taskbar_hint(GTK_WINDOW(window), TRUE);
+    gtk_window_set_skip_pager_hint(GTK_WINDOW(window), TRUE);
+    gtk_window_set_position(GTK_WINDOW(window), GTK_WIN_POS_MOUSE);
+    gtk_window_set_default_size(GTK_WINDOW(window), GUI_VIRTUAL_POPUP_WIDTH, GUI_VIRTUAL_POPUP_HEIGHT);
+    g_signal_connect(G_OBJECT(window), "key-press-event", on_keypress, NULL);
+    g_signal_connect_after(G_OBJECT(window), "key-press-event", G_CALLBACK(clip_gui_list_cb_keypress), NULL);
+    g_signal_connect(G_OBJECT(window), "focus-out-event", G_CALLBACK(clip_gui_list_cb_focus_out), NULL);
+    g_signal_connect(G_OBJECT(window), "delete-event", G_CALLBACK(gtk_widget_hide_on_delete), NULL);
+
+    status = gtk_label_new(NULL);
+    gtk_widget_set_halign(status, GTK_ALIGN_START);
+
+    tree = gtk_tree_view_new();
+    gtk_tree_view_set_headers_visible(GTK_TREE_VIEW(tree), FALSE);
+    gtk_tree_view_set_enable_search(GTK_TREE_VIEW(tree), FALSE);
+    // Rows all have the same height, so the view never measures rows that aren't visible.
+    gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW(tree), TRUE);
+    g_signal_connect(G_OBJECT(tree), "row-activated", G_CALLBACK(clip_gui_list_cb_row_activated), NULL);
+    g_signal_connect(G_OBJECT(tree), "button-release-event", G_CALLBACK(clip_gui_list_cb_toggle_lock), NULL);
+
+    GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
+    g_object_set(renderer, "ellipsize", PANGO_ELLIPSIZE_END, "single-paragraph-mode", TRUE, NULL);
+    GtkTreeViewColumn *column = gtk_tree_view_column_new();
+    gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+    gtk_tree_view_column_pack_start(column, renderer, TRUE);
+    gtk_tree_view_column_set_cell_data_func(column, renderer, clip_gui_list_cb_render_row, NULL, NULL);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(tree), column);
+
+    GtkWidget *scrolled = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_widget_set_vexpand(scrolled, TRUE);
+    gtk_container_add(GTK_CONTAINER(scrolled), tree);
+
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    gtk_box_pack_start(GTK_BOX(box), status, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(box), scrolled, TRUE, TRUE, 0);
+    gtk_container_add(GTK_CONTAINER(window), box);
+
+    list_rows = g_array_new(FALSE, FALSE, sizeof(ListRow));
+    list_slots = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+    clip_gui_list_refresh();
+    clip_events_add_batch_observer(clip_gui_list_on_events);
+    return &list_view;
+}
+
+void clip_gui_list_destroy(void)
+{
+    gtk_widget_destroy(window);
+    window = NULL;
+    status = NULL;
+    tree = NULL;
+
+    g_object_unref(model);
+    model = NULL;
+    clip_gui_list_clear_rows();
+    g_array_free(list_rows, TRUE);
+    list_rows = NULL;
+    g_hash_table_destroy(list_slots);
+    list_slots = NULL;
+    clip_history_snapshot_unref(snapshot);
+    snapshot = NULL;
+    clipboard = NULL;
+}
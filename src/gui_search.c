@@ -20,13 +20,95 @@
  */
 
 #include "gui_search.h"
+#include "config.h"
+#include "search.h"
 #include "utils.h"
 
 #include <gtk/gtk.h>
+#include <string.h>
 
 
+/**
+ * The rows matching one prefix of the search term. Each appended character pushes a new set, so removing a character
+ * restores the previous set, and its selection, without searching again.
+ */
+typedef struct SearchMatches {
+    gsize length;
+    gboolean narrows;
+    gboolean valid;
+    gboolean complete;
+    GArray *rows;
+    guint selected;
+} SearchMatches;
+
 static GString *search_term = NULL;
-static int position = 0;
+static gboolean fuzzy = FALSE;
+static GPtrArray *matches = NULL;
+static GHashTable *patterns = NULL;
+// The search for the current term's matches, while it's running.
+static GCancellable *running = NULL;
+static GuiSearchNotify notify = NULL;
+
+
+static SearchMatches* clip_gui_search_matches_new(gsize length, gboolean narrows)
+{
+    SearchMatches *level = g_malloc(sizeof(SearchMatches));
+    level->length = length;
+    level->narrows = narrows;
+    level->valid = FALSE;
+    level->complete = FALSE;
+    level->rows = g_array_new(FALSE, FALSE, sizeof(ClipSearchMatch));
+    level->selected = 0;
+    return level;
+}
+
+static void clip_gui_search_matches_clear(SearchMatches *level)
+{
+    level->valid = FALSE;
+    level->complete = FALSE;
+    g_array_set_size(level->rows, 0);
+    level->selected = 0;
+}
+
+static void clip_gui_search_matches_free(SearchMatches *level)
+{
+    g_array_free(level->rows, TRUE);
+    g_free(level);
+}
+
+static SearchMatches* clip_gui_search_get_matches(void)
+{
+    return g_ptr_array_index(matches, matches->len - 1);
+}
+
+static void clip_gui_search_cancel(void)
+{
+    if(running != NULL){
+        g_cancellable_cancel(running);
+        g_object_unref(running);
+        running = NULL;
+    }
+}
+
+static gboolean clip_gui_search_is_meta(gunichar c)
+{
+    return c < 0x80 && strchr("\\^$.|?*+()[]{}", c) != NULL;
+}
+
+/**
+ * Identifies if appending c to the current term can only remove matches. For fuzzy terms that's always the case. For
+ * patterns, c must be a literal and the term must have no escapes or options which could change its meaning.
+ */
+static gboolean clip_gui_search_narrows(gunichar c)
+{
+    if(search_term->len > 0 && fuzzy){
+        return TRUE;
+    } else if(search_term->len == 0 || clip_gui_search_is_meta(c)){
+        return FALSE;
+    }
+    return strchr(search_term->str, '\\') == NULL && strstr(search_term->str, "(?") == NULL;
+}
+
 
 /**
  * Identifies if a search is currenty in progress.
@@ -46,25 +128,60 @@ void clip_gui_search_end(void)
     }
 
     trace("Ending search.\n");
+    clip_gui_search_cancel();
     if(search_term != NULL){
         g_string_free(search_term, TRUE);
         search_term = NULL;
-        position = 0;
+        g_ptr_array_free(matches, TRUE);
+        matches = NULL;
     }
 }
 
-/**
- * Begins the search mode. If already in search mode, simply pass through.
- */
-void clip_gui_search_start(void)
+static void clip_gui_search_begin(gboolean _fuzzy)
 {
     if(clip_gui_search_in_progress()){
         return;
     }
 
-    trace("Starting new search.\n");
+    trace("Starting new %s search.\n", _fuzzy ? "fuzzy" : "pattern");
     search_term = g_string_new(NULL);
-    position = 0;
+    fuzzy = _fuzzy;
+    matches = g_ptr_array_new_with_free_func((GDestroyNotify)clip_gui_search_matches_free);
+    g_ptr_array_add(matches, clip_gui_search_matches_new(0, FALSE));
+}
+
+/**
+ * Begins the search mode, matching the term as a regular expression. If already in search mode, simply pass through.
+ */
+void clip_gui_search_start(void)
+{
+    clip_gui_search_begin(FALSE);
+}
+
+/**
+ * Begins the search mode, matching rows which contain the term's characters in order. Matches are ranked by score. If
+ * already in search mode, simply pass through.
+ */
+void clip_gui_search_start_fuzzy(void)
+{
+    clip_gui_search_begin(TRUE);
+}
+
+gboolean clip_gui_search_is_fuzzy(void)
+{
+    return clip_gui_search_in_progress() && fuzzy;
+}
+
+/**
+ * Releases the compiled patterns.
+ */
+void clip_gui_search_destroy(void)
+{
+    clip_gui_search_end();
+    if(patterns != NULL){
+        g_hash_table_destroy(patterns);
+        patterns = NULL;
+    }
 }
 
 
@@ -83,19 +200,187 @@ int clip_gui_search_get_length(void)
     return search_term->len;
 }
 
-int clip_gui_search_get_position(void)
+/**
+ * Returns the compiled pattern for the search term, or NULL if the term isn't a valid pattern. Patterns are compiled
+ * once and cached, so returning to an earlier term doesn't compile it again.
+ */
+GRegex* clip_gui_search_get_pattern(void)
 {
-    return position;
+    if(patterns == NULL){
+        patterns = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_regex_unref);
+    }
+
+    GRegex *pattern = g_hash_table_lookup(patterns, search_term->str);
+    if(pattern != NULL){
+        return pattern;
+    }
+
+    GError *error = NULL;
+    pattern = g_regex_new(search_term->str, G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, &error);
+    if(pattern == NULL){
+        debug("Search term, '%s', isn't a valid pattern: %s\n", search_term->str, error->message);
+        g_error_free(error);
+        return NULL;
+    }
+
+    if(g_hash_table_size(patterns) >= GUI_SEARCH_PATTERN_CACHE_SIZE){
+        g_hash_table_remove_all(patterns);
+    }
+    g_hash_table_insert(patterns, g_strdup(search_term->str), pattern);
+    return pattern;
 }
 
-void clip_gui_search_set_position(int _position)
+
+static gint clip_gui_search_compare_matches(const ClipSearchMatch *a, const ClipSearchMatch *b)
 {
-    position = _position;
+    if(a->score != b->score){
+        return a->score > b->score ? -1 : 1;
+    }
+    return a->row - b->row;
 }
 
-void clip_gui_search_increment_position(void)
+/**
+ * Identifies if the rows matching the current term have all been found.
+ */
+gboolean clip_gui_search_is_complete(void)
+{
+    return clip_gui_search_get_matches()->complete;
+}
+
+/**
+ * Identifies if the rows matching the current term are still being found.
+ */
+gboolean clip_gui_search_is_running(void)
+{
+    return running != NULL;
+}
+
+/**
+ * Discards every set of matches, stopping any search. This must be called whenever the rows change.
+ */
+void clip_gui_search_invalidate(void)
+{
+    if(!clip_gui_search_in_progress()){
+        return;
+    }
+    clip_gui_search_cancel();
+    for(guint i = 0; i < matches->len; i++){
+        clip_gui_search_matches_clear(g_ptr_array_index(matches, i));
+    }
+}
+
+/**
+ * Adds a batch of matches to the current term's. Any change to the term cancels its search, so the batch always
+ * belongs to the current term. Fuzzy matches are kept ranked by score, with more recent rows first among equal scores.
+ */
+static void clip_gui_search_cb_matches(GArray *batch, gboolean done, gpointer user_data)
+{
+    SearchMatches *level = clip_gui_search_get_matches();
+    g_array_append_vals(level->rows, batch->data, batch->len);
+    if(fuzzy){
+        g_array_sort(level->rows, (GCompareFunc)clip_gui_search_compare_matches);
+    }
+
+    if(done){
+        level->complete = TRUE;
+        level->valid = TRUE;
+        g_object_unref(running);
+        running = NULL;
+        trace("Found %d matches for '%s'.\n", level->rows->len, search_term->str);
+    }
+    notify(done);
+}
+
+/**
+ * Identifies if the term is a pattern which only matches itself, so it could be looked up in the history's index.
+ */
+gboolean clip_gui_search_is_literal(void)
 {
-    position++;
+    if(fuzzy){
+        return FALSE;
+    }
+    for(const char *c = search_term->str; *c != '\0'; c++){
+        if(clip_gui_search_is_meta(*c)){
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * Starts finding the rows matching the current term on a worker thread, unless they're already found or being found.
+ * Rows are read from the snapshot, where snapshot row i must be view row i. notify is called as matches arrive.
+ * <br />
+ * If ids isn't NULL, only the rows with those ids are searched; this takes ownership of the array. Otherwise, when the
+ * term narrows the previous term, only the previous term's matches are searched.
+ */
+void clip_gui_search_find(ClipboardHistorySnapshot *rows, GArray *ids, GuiSearchNotify _notify)
+{
+    SearchMatches *level = clip_gui_search_get_matches();
+    if(level->complete || running != NULL){
+        if(ids != NULL){
+            g_array_free(ids, TRUE);
+        }
+        return;
+    }
+
+    GRegex *pattern = NULL;
+    if(!fuzzy && (pattern = clip_gui_search_get_pattern()) == NULL){
+        level->complete = TRUE;
+        if(ids != NULL){
+            g_array_free(ids, TRUE);
+        }
+        return;
+    }
+
+    GArray *candidates = NULL;
+    SearchMatches *previous = matches->len < 2 ? NULL : g_ptr_array_index(matches, matches->len - 2);
+    if(ids == NULL && level->narrows && previous != NULL && previous->complete && previous->valid){
+        candidates = g_array_sized_new(FALSE, FALSE, sizeof(int), previous->rows->len);
+        for(guint i = 0; i < previous->rows->len; i++){
+            g_array_append_val(candidates, g_array_index(previous->rows, ClipSearchMatch, i).row);
+        }
+    }
+
+    notify = _notify;
+    level->selected = 0;
+    running = clip_search_start(rows, pattern, search_term->str, candidates, ids, clip_gui_search_cb_matches, NULL);
+}
+
+/**
+ * Returns the selected row matching the current term, or -1 if nothing matches.
+ */
+int clip_gui_search_get_match(void)
+{
+    SearchMatches *level = clip_gui_search_get_matches();
+    if(level->rows->len == 0){
+        return -1;
+    }
+    return g_array_index(level->rows, ClipSearchMatch, level->selected).row;
+}
+
+/**
+ * Returns a new array of the rows matching the current term, in ranked order.
+ */
+GArray* clip_gui_search_get_ranking(void)
+{
+    SearchMatches *level = clip_gui_search_get_matches();
+    GArray *ranking = g_array_sized_new(FALSE, FALSE, sizeof(int), level->rows->len);
+    for(guint i = 0; i < level->rows->len; i++){
+        g_array_append_val(ranking, g_array_index(level->rows, ClipSearchMatch, i).row);
+    }
+    return ranking;
+}
+
+/**
+ * Selects the next row matching the current term, wrapping around after the last.
+ */
+void clip_gui_search_next_match(void)
+{
+    SearchMatches *level = clip_gui_search_get_matches();
+    if(level->rows->len > 0){
+        level->selected = (level->selected + 1) % level->rows->len;
+    }
 }
 
 
@@ -110,8 +395,10 @@ void clip_gui_search_remove_char(void)
         return;
     }
 
+    clip_gui_search_cancel();
     if(search_term->len > 0){
-        g_string_set_size(search_term, search_term->len  - 1);
+        g_ptr_array_remove_index(matches, matches->len - 1);
+        g_string_set_size(search_term, clip_gui_search_get_matches()->length);
     } else {
         clip_gui_search_end();
     }
@@ -146,7 +433,9 @@ void clip_gui_search_append(guint keyval)
         return;
     }
 
+    clip_gui_search_cancel();
+    gboolean narrows = clip_gui_search_narrows(c);
     g_string_append_unichar(search_term, c);
-    position = 0;
+    g_ptr_array_add(matches, clip_gui_search_matches_new(search_term->len, narrows));
     trace("Searching for, '%s'.\n", search_term->str);
 }
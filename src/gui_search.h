@@ -19,10 +19,22 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include "history_snapshot.h"
+
 #include <glib.h>
 
+#ifndef __CLIP_GUI_SEARCH_TYPES__
+#define __CLIP_GUI_SEARCH_TYPES__
+/**
+ * Called as matches for the search term are found. done is set once they have all been found.
+ */
+typedef void (*GuiSearchNotify)(gboolean done);
+#endif
+
 void clip_gui_search_end(void);
 void clip_gui_search_start(void);
+void clip_gui_search_start_fuzzy(void);
+gboolean clip_gui_search_is_fuzzy(void);
 gboolean clip_gui_search_in_progress(void);
 
 
@@ -33,6 +45,16 @@ void clip_gui_search_remove_char(void);
 char* clip_gui_search_get_term(void);
 int clip_gui_search_get_length(void);
 
-int clip_gui_search_get_position(void);
-void clip_gui_search_set_position(int position);
-void clip_gui_search_increment_position(void);
+GRegex* clip_gui_search_get_pattern(void);
+
+gboolean clip_gui_search_is_literal(void);
+void clip_gui_search_find(ClipboardHistorySnapshot *rows, GArray *ids, GuiSearchNotify notify);
+gboolean clip_gui_search_is_complete(void);
+gboolean clip_gui_search_is_running(void);
+void clip_gui_search_invalidate(void);
+
+int clip_gui_search_get_match(void);
+GArray* clip_gui_search_get_ranking(void);
+void clip_gui_search_next_match(void);
+
+void clip_gui_search_destroy(void);
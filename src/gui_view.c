@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "gui_view.h"
+
+#include "config.h"
+
+#include <glib.h>
+#include <string.h>
+
+// Rendered markup by row key. The cache is emptied once it reaches its limit.
+#define GUI_VIEW_CACHE_LIMIT 1024
+static GHashTable *cache = NULL;
+
+static guint clip_gui_view_key_hash(GuiRowKey *key)
+{
+    return g_int64_hash(&key->id) ^ (key->version * 31) ^ (key->row << 1) ^ key->head ^ (key->pending << 1);
+}
+
+void clip_gui_view_get_key(Clipboard *clipboard, GuiRow *row, GuiRowKey *key)
+{
+    // Zero the padding so keys can be copied and compared as a whole.
+    memset(key, 0, sizeof(GuiRowKey));
+    key->id = row->id;
+    key->version = row->version;
+    key->row = row->row;
+    key->head = clip_clipboard_is_head_text(clipboard, row->text, row->length);
+    key->pending = clip_clipboard_is_transforming(clipboard, row->id);
+}
+
+gboolean clip_gui_view_key_equals(GuiRowKey *a, GuiRowKey *b)
+{
+    return a->id == b->id && a->version == b->version && a->row == b->row && a->head == b->head
+        && a->pending == b->pending;
+}
+
+static char* clip_gui_view_format_row(GuiRow *row, gboolean head, gboolean pending)
+{
+    char *shortened = row->masked
+        ? g_strnfill(MIN(GUI_DISPLAY_CHARACTERS, row->length), GUI_MASK_CHAR)
+        : g_strndup(row->text, MIN(GUI_DISPLAY_CHARACTERS, row->length));
+
+    GString *mask = g_string_new("%s");
+
+    if(row->locked){
+        g_string_prepend(mask, "<b>");
+        g_string_append(mask, "</b>");
+    }
+
+    if(head){
+        g_string_prepend(mask, "<i>");
+        g_string_append(mask, "</i>");
+    }
+
+    // The old text is shown greyed out until the transformed text is saved.
+    if(pending){
+        g_string_prepend(mask, "<span foreground='gray'>");
+        g_string_append(mask, "</span>");
+    }
+
+    if(row->tag != 0){
+        GString *tagged = g_string_new("");
+        g_string_printf(tagged, "<span foreground='gray'>%c</span> %s", row->tag, mask->str);
+        g_string_free(mask, TRUE);
+        mask = tagged;
+    }
+
+    if(row->row < 10){
+        GString *numbered = g_string_new("");
+        g_string_printf(numbered, "<span foreground='gray'>%d</span> %s", row->row, mask->str);
+        g_string_free(mask, TRUE);
+        mask = numbered;
+    }
+
+    char *markedup = g_markup_printf_escaped(mask->str, shortened);
+    g_string_free(mask, TRUE);
+    g_free(shortened);
+    return markedup;
+}
+
+const char* clip_gui_view_render_row(Clipboard *clipboard, GuiRow *row)
+{
+    if(cache == NULL){
+        cache = g_hash_table_new_full((GHashFunc)clip_gui_view_key_hash, (GEqualFunc)clip_gui_view_key_equals, g_free, g_free);
+    }
+
+    GuiRowKey key;
+    clip_gui_view_get_key(clipboard, row, &key);
+    char *markedup = g_hash_table_lookup(cache, &key);
+    if(markedup == NULL){
+        if(g_hash_table_size(cache) >= GUI_VIEW_CACHE_LIMIT){
+            g_hash_table_remove_all(cache);
+        }
+        markedup = clip_gui_view_format_row(row, key.head, key.pending);
+        GuiRowKey *cached = g_new(GuiRowKey, 1);
+        *cached = key;
+        g_hash_table_insert(cache, cached, markedup);
+    }
+    return markedup;
+}
+
+void clip_gui_view_clear_cache(void)
+{
+    if(cache != NULL){
+        g_hash_table_remove_all(cache);
+    }
+}
+
+const char* clip_gui_view_trim_label(TrimMode mode)
+{
+    switch(mode){
+        case TRIM_OFF:
+        case TRIM_STOP:  return GUI_AUTO_TRIM_MESSAGE " (Off)";
+        case TRIM_CHOMP: return GUI_AUTO_TRIM_MESSAGE " (Trim Right)";
+        case TRIM_CHUG:  return GUI_AUTO_TRIM_MESSAGE " (Trim Left)";
+        case TRIM_STRIP: return GUI_AUTO_TRIM_MESSAGE " (Trim Both)";
+    }
+    return GUI_AUTO_TRIM_MESSAGE;
+}
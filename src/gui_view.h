@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "clipboard.h"
+
+#include <glib.h>
+#include <gtk/gtk.h>
+
+#ifndef __CLIP_GUI_VIEW_TYPES__
+#define __CLIP_GUI_VIEW_TYPES__
+/**
+ * A history row as seen by the key handler, independent of how a view presents it.
+ */
+typedef struct {
+    int row;
+    int64_t id;
+    // The entry's version, or 0 if the row is read from a snapshot.
+    guint version;
+    const char *text;
+    gsize length;
+    gboolean locked;
+    gboolean masked;
+    char tag;
+} GuiRow;
+
+typedef gboolean (*GuiRowPredicate)(GuiRow *row);
+
+/**
+ * Everything that determines how a row is rendered.
+ */
+typedef struct {
+    int64_t id;
+    guint version;
+    int row;
+    gboolean head;
+    // Set while the entry is being transformed.
+    gboolean pending;
+} GuiRowKey;
+
+/**
+ * A popup presentation of the history. The key handler in gui.c drives whichever view is configured.
+ */
+typedef struct {
+    // Returns the widget that's mapped when the view is shown.
+    GtkWidget* (*get_widget)(void);
+    void (*show)(void);
+    void (*hide)(void);
+    // Refresh everything other than the history rows (e.g. the search term).
+    void (*update)(void);
+    // Returns a reference to the selected row's entry, or NULL.
+    ClipboardEntry* (*get_selected)(void);
+    // Returns the first row at or after start that satisfies the predicate, or -1.
+    int (*find)(GuiRowPredicate predicate, int start);
+    // Returns the row holding the tag, or -1.
+    int (*find_tag)(char tag);
+    // Selects the row. A negative row clears the selection.
+    void (*select)(int row);
+    void (*activate)(int row);
+    // Shows only the given rows, in the given order. NULL shows every row, in history order.
+    void (*filter)(GArray *rows);
+    // Returns a new reference to a snapshot of every row, where snapshot row i is the view's row i.
+    ClipboardHistorySnapshot* (*get_rows)(void);
+} GuiView;
+#endif
+
+void clip_gui_view_get_key(Clipboard *clipboard, GuiRow *row, GuiRowKey *key);
+gboolean clip_gui_view_key_equals(GuiRowKey *a, GuiRowKey *b);
+/**
+ * Returns the markup used to display the row. Markup is cached by the row's key, so this value must not be modified and
+ * is only valid until the next call.
+ */
+const char* clip_gui_view_render_row(Clipboard *clipboard, GuiRow *row);
+/**
+ * Drops all cached markup. This must be done when rows are read from a new snapshot.
+ */
+void clip_gui_view_clear_cache(void);
+/**
+ * Returns the label of the auto-trim toggle for the trim mode. This value must not be modified.
+ */
+const char* clip_gui_view_trim_label(TrimMode mode);
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "histogram.h"
+#include "utils.h"
+
+#include <glib.h>
+
+// Bucket i holds samples below 2^i microseconds (and at least 2^(i-1)). The last bucket holds everything else.
+#define HISTOGRAM_BUCKETS 32
+
+struct histogram {
+    char *name;
+    guint64 count;
+    gint64 total;
+    gint64 max;
+    guint64 buckets[HISTOGRAM_BUCKETS];
+};
+
+ClipHistogram* clip_histogram_new(const char *name)
+{
+    ClipHistogram *histogram = g_malloc0(sizeof(ClipHistogram));
+    histogram->name = g_strdup(name);
+    return histogram;
+}
+
+void clip_histogram_free(ClipHistogram *histogram)
+{
+    if(histogram == NULL){
+        return;
+    }
+    g_free(histogram->name);
+    g_free(histogram);
+}
+
+static guint clip_histogram_bucket(gint64 microseconds)
+{
+    guint bucket = 0;
+    while(microseconds > 0 && bucket < HISTOGRAM_BUCKETS - 1){
+        microseconds >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void clip_histogram_record(ClipHistogram *histogram, gint64 microseconds)
+{
+    microseconds = MAX(microseconds, 0);
+    histogram->buckets[clip_histogram_bucket(microseconds)]++;
+    histogram->count++;
+    histogram->total += microseconds;
+    histogram->max = MAX(histogram->max, microseconds);
+
+    trace("%s: %"G_GINT64_FORMAT"us.\n", histogram->name, microseconds);
+    if(histogram->count % HISTOGRAM_REPORT_INTERVAL == 0){
+        clip_histogram_log(histogram);
+    }
+}
+
+/**
+ * Returns the upper bound of the bucket holding the percentile.
+ */
+static gint64 clip_histogram_percentile(ClipHistogram *histogram, guint percentile)
+{
+    guint64 target = (histogram->count * percentile + 99) / 100;
+    guint64 seen = 0;
+    for(guint i = 0; i < HISTOGRAM_BUCKETS; i++){
+        seen += histogram->buckets[i];
+        if(seen >= target){
+            return i == HISTOGRAM_BUCKETS - 1 ? histogram->max : ((gint64)1 << i);
+        }
+    }
+    return histogram->max;
+}
+
+void clip_histogram_log(ClipHistogram *histogram)
+{
+    if(histogram->count == 0){
+        debug("%s: no samples.\n", histogram->name);
+        return;
+    }
+
+    debug("%s: %"G_GUINT64_FORMAT" samples, mean %"G_GINT64_FORMAT"us, p50 <%"G_GINT64_FORMAT"us, "
+            "p90 <%"G_GINT64_FORMAT"us, p99 <%"G_GINT64_FORMAT"us, max %"G_GINT64_FORMAT"us.\n",
+            histogram->name, histogram->count, histogram->total / (gint64)histogram->count,
+            clip_histogram_percentile(histogram, 50), clip_histogram_percentile(histogram, 90),
+            clip_histogram_percentile(histogram, 99), histogram->max);
+    for(guint i = 0; i < HISTOGRAM_BUCKETS; i++){
+        if(histogram->buckets[i] > 0){
+            debug("%s:   <%12"G_GINT64_FORMAT"us %8"G_GUINT64_FORMAT"\n", histogram->name, (gint64)1 << i,
+                    histogram->buckets[i]);
+        }
+    }
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+
+typedef struct histogram ClipHistogram;
+
+/**
+ * Creates a histogram of durations in microseconds. Samples are counted in power of two buckets, so recording a sample
+ * is constant time and the histogram has a fixed size.
+ */
+ClipHistogram* clip_histogram_new(const char *name);
+void clip_histogram_free(ClipHistogram *histogram);
+
+/**
+ * Records a sample. Every HISTOGRAM_REPORT_INTERVAL samples, the histogram is logged.
+ */
+void clip_histogram_record(ClipHistogram *histogram, gint64 microseconds);
+void clip_histogram_log(ClipHistogram *histogram);
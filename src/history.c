@@ -22,6 +22,7 @@
 #include "clipboard_events.h"
 #include "config.h"
 #include "history.h"
+#include "history_snapshot.h"
 #include "utils.h"
 
 #include <stdlib.h>
@@ -40,6 +41,30 @@
                                "    masked INT NOT NULL DEFAULT 0"\
                                ")"
 
+/*
+ * A trigram index over the text, kept up to date by triggers. The index is an external content table, so it holds
+ * no copy of the text. Replacing a row only fires the delete trigger with recursive triggers enabled.
+ */
+#define HISTORY_SEARCH_EXISTS "SELECT count(*) FROM sqlite_master WHERE name = 'history_search'"
+#define HISTORY_SEARCH_CREATE "PRAGMA recursive_triggers = ON;"\
+                               "CREATE VIRTUAL TABLE IF NOT EXISTS history_search USING fts5("\
+                               "    text, content = 'history', content_rowid = 'id', tokenize = 'trigram'"\
+                               ");"\
+                               "CREATE TRIGGER IF NOT EXISTS history_search_insert AFTER INSERT ON history BEGIN"\
+                               "    INSERT INTO history_search(rowid, text) VALUES(new.id, new.text);"\
+                               "END;"\
+                               "CREATE TRIGGER IF NOT EXISTS history_search_delete AFTER DELETE ON history BEGIN"\
+                               "    INSERT INTO history_search(history_search, rowid, text) VALUES('delete', old.id, old.text);"\
+                               "END;"\
+                               "CREATE TRIGGER IF NOT EXISTS history_search_update AFTER UPDATE OF text ON history"\
+                               "    WHEN old.text IS NOT new.text BEGIN"\
+                               "    INSERT INTO history_search(history_search, rowid, text) VALUES('delete', old.id, old.text);"\
+                               "    INSERT INTO history_search(rowid, text) VALUES(new.id, new.text);"\
+                               "END"
+#define HISTORY_SEARCH_REBUILD "INSERT INTO history_search(history_search) VALUES('rebuild')"
+// Trigrams can only find terms of at least three characters.
+#define HISTORY_SEARCH_MIN_LENGTH 3
+
 #define HISTORY_INSERT_EXISTING "UPDATE history SET text = ?1, created = current_timestamp, usage_count = usage_count + 1, masked = ?2 WHERE id = ?3"
 // Rather than doing an insert+select+update or a constraint violation, just do a replace.
 #define HISTORY_INSERT_NEW "INSERT OR REPLACE INTO history(id, text, created, locked, usage_count, tag, masked) VALUES( "\
@@ -48,7 +73,7 @@
                                 "(SELECT locked FROM history WHERE text = ?1), "\
                                 "(SELECT usage_count + 1 FROM history WHERE text = ?1), "\
                                 "(SELECT tag FROM history WHERE text = ?1), "\
-                                "(SELECT masked FROM history WHERE text = ?1)"\
+                                "MAX(?2, IFNULL((SELECT masked FROM history WHERE text = ?1), 0))"\
                                 ")"
 
 #define HISTORY_UPDATE_BY_ID "UPDATE history SET "\
@@ -58,27 +83,126 @@
                                 "masked = ?4 "\
                                 "WHERE id = ?5"
 
+#define HISTORY_UPDATE_LOCKED_BY_ID "UPDATE history SET locked = ?1 WHERE id = ?2"
+#define HISTORY_UPDATE_MASKED_BY_ID "UPDATE history SET masked = ?1 WHERE id = ?2"
+#define HISTORY_UPDATE_TAG_BY_ID "UPDATE history SET tag = ?1 WHERE id = ?2"
+
 #define HISTORY_DELETE_UNLOCKED_BY_ID "DELETE FROM history WHERE id = ? AND locked = 0"
-#define HISTORY_DELETE_UNLOCKED_BY_AGE "DELETE FROM history WHERE id = (SELECT max(id) FROM history WHERE locked = 0)"
 
 #define HISTORY_CLEAR "DELETE FROM history WHERE locked = 0"
 
+#define HISTORY_BEGIN "BEGIN IMMEDIATE"
+#define HISTORY_COMMIT "COMMIT"
+#define HISTORY_ROLLBACK "ROLLBACK"
+
+#define HISTORY_SELECT_NEWEST_UNLOCKED "SELECT max(id) FROM history WHERE locked = 0"
 // Use a LRU+LFU eviction policy.
-#define HISTORY_EVICT_SINGLE "DELETE FROM history WHERE id = (SELECT id FROM history WHERE locked = 0 ORDER BY usage_count, id LIMIT 1)"
+#define HISTORY_SELECT_EVICTABLE "SELECT id FROM history WHERE locked = 0 ORDER BY usage_count, id LIMIT 1"
 
-#define HISTORY_SELECT_ALL "SELECT id, text, locked, usage_count, tag, masked FROM history ORDER BY created, id"
+#define HISTORY_SELECT_RECENT "SELECT id, text, locked, usage_count, tag, masked FROM history ORDER BY created DESC, id DESC LIMIT ?1"
 #define HISTORY_SELECT_BY_TEXT "SELECT id, text, locked, usage_count, tag, masked FROM history WHERE text = ?1"
+#define HISTORY_SELECT_BY_ID "SELECT id, text, locked, usage_count, tag, masked FROM history WHERE id = ?1"
+#define HISTORY_SELECT_BY_TAG "SELECT id, text, locked, usage_count, tag, masked FROM history WHERE tag = ?1"
+#define HISTORY_SELECT_NTH "SELECT id, text, locked, usage_count, tag, masked FROM history ORDER BY created DESC, id DESC "\
+                                "LIMIT 1 OFFSET ?1"
+#define HISTORY_SELECT_NEXT "SELECT id, text, locked, usage_count, tag, masked FROM history "\
+                                "WHERE (created, id) < (SELECT created, id FROM history WHERE id = ?1) "\
+                                "ORDER BY created DESC, id DESC LIMIT 1"
 #define HISTORY_SELECT_COUNT "SELECT count(*) FROM history"
+#define HISTORY_SELECT_EXISTS_BY_ID "SELECT count(*) FROM history WHERE id = ?1"
+// Snapshots are sized from the row count alone, since summing the text's length reads every value. The arena grows if
+// the history's text is longer than this per row.
+#define HISTORY_SNAPSHOT_ROW_TEXT_SIZE 128
+#define HISTORY_SELECT_SNAPSHOT "SELECT id, text, locked, tag, masked FROM history ORDER BY created DESC, id DESC"
+#define HISTORY_SELECT_MATCHING "SELECT h.id, h.text, h.locked, h.usage_count, h.tag, h.masked FROM history_search s "\
+                                "JOIN history h ON h.id = s.rowid WHERE history_search MATCH ?1 "\
+                                "ORDER BY h.created DESC, h.id DESC LIMIT ?2"
+#define HISTORY_SELECT_MATCHING_IDS "SELECT rowid FROM history_search WHERE history_search MATCH ?1"
+#define HISTORY_SELECT_CONTAINING "SELECT id, text, locked, usage_count, tag, masked FROM history "\
+                                "WHERE instr(lower(text), lower(?1)) > 0 ORDER BY created DESC, id DESC LIMIT ?2"
 
-static int levenshtein_distance(const char *s, const char *t);
-static ClipboardEntry* clip_history_get_by_text(ClipboardHistory *history, char *text);
+static int levenshtein_distance(const char *s, int ls, const char *t, int lt);
+static ClipboardEntry* clip_history_get_by_text(ClipboardHistory *history, ClipboardText *text);
 
 struct history {;
     sqlite3 *storage;
     int count;
+    // Whether the search index is available.
+    gboolean indexed;
     GList *observers;
+    // Identity map of id to the one live entry for that id. The map doesn't hold references: an entry is dropped from it
+    // when its last reference is released, so only entries someone is using stay in memory. Entries are only released on
+    // the main thread.
+    GHashTable *entries;
+    // Nesting depth of the open batch. Events are queued until the outermost batch commits.
+    int batch_depth;
+    gboolean batch_failed;
+    GQueue *pending_events;
 };
 
+typedef struct {
+    ClipboardEvent event;
+    ClipboardEntry *entry;
+} PendingEvent;
+
+
+static ClipboardEntry* clip_history_identity_get(ClipboardHistory *history, int64_t id)
+{
+    return g_hash_table_lookup(history->entries, &id);
+}
+
+static void clip_history_identity_cb_finalize(ClipboardEntry *entry, ClipboardHistory *history)
+{
+    int64_t id = clip_clipboard_entry_get_id(entry);
+    if(clip_history_identity_get(history, id) == entry){
+        g_hash_table_remove(history->entries, &id);
+    }
+}
+
+/**
+ * Stops the entry being dropped from the map when it's released.
+ */
+static void clip_history_identity_forget(ClipboardEntry *entry)
+{
+    clip_clipboard_entry_set_finalize_notify(entry, NULL, NULL);
+}
+
+static void clip_history_cb_forget_entry(gpointer id, ClipboardEntry *entry, gpointer user_data)
+{
+    clip_history_identity_forget(entry);
+}
+
+static void clip_history_identity_remove(ClipboardHistory *history, int64_t id)
+{
+    ClipboardEntry *entry = clip_history_identity_get(history, id);
+    if(entry != NULL){
+        clip_history_identity_forget(entry);
+        g_hash_table_remove(history->entries, &id);
+    }
+}
+
+static void clip_history_identity_put(ClipboardHistory *history, ClipboardEntry *entry)
+{
+    int64_t id = clip_clipboard_entry_get_id(entry);
+    if(clip_history_identity_get(history, id) == entry){
+        return;
+    }
+    clip_history_identity_remove(history, id);
+
+    int64_t *key = g_new(int64_t, 1);
+    *key = id;
+    g_hash_table_insert(history->entries, key, entry);
+    clip_clipboard_entry_set_finalize_notify(entry, (ClipboardEntryNotify)clip_history_identity_cb_finalize, history);
+}
+
+/**
+ * Binds the buffer's text without copying it. The buffer must outlive the statement's execution.
+ */
+static void clip_history_bind_text(sqlite3_stmt *statement, int index, ClipboardText *text)
+{
+    sqlite3_bind_text(statement, index, clip_clipboard_text_get_str(text), clip_clipboard_text_get_length(text), SQLITE_STATIC);
+}
+
 static void clip_history_storage_count(ClipboardHistory *history)
 {
     sqlite3_stmt *statement = NULL;
@@ -92,6 +216,54 @@ static void clip_history_storage_count(ClipboardHistory *history)
     sqlite3_finalize(statement);
 }
 
+static gboolean clip_history_storage_exists(ClipboardHistory *history, int64_t id)
+{
+    gboolean exists = FALSE;
+    sqlite3_stmt *statement = NULL;
+    int status = sqlite3_prepare(history->storage, HISTORY_SELECT_EXISTS_BY_ID, -1, &statement, NULL);
+    if(status == SQLITE_OK){
+        sqlite3_bind_int64(statement, 1, id);
+        if(sqlite3_step(statement) == SQLITE_ROW){
+            exists = sqlite3_column_int(statement, 0) > 0;
+        }
+    } else {
+        warn("Couldn't prepare existence check for %"PRIu64" (error %d).\n", id, status);
+    }
+    sqlite3_finalize(statement);
+    return exists;
+}
+
+/**
+ * Creates the search index if it doesn't exist yet, indexing any existing history. Without FTS5, searches fall back to
+ * scanning the history.
+ */
+static void clip_history_storage_index(ClipboardHistory *history)
+{
+    gboolean exists = FALSE;
+    sqlite3_stmt *statement = NULL;
+    int status = sqlite3_prepare(history->storage, HISTORY_SEARCH_EXISTS, -1, &statement, NULL);
+    if(status == SQLITE_OK && sqlite3_step(statement) == SQLITE_ROW){
+        exists = sqlite3_column_int(statement, 0) > 0;
+    }
+    sqlite3_finalize(statement);
+
+    status = sqlite3_exec(history->storage, HISTORY_SEARCH_CREATE, NULL, NULL, NULL);
+    if(status != SQLITE_OK){
+        warn("Cannot create history search index. Searches will scan the history (error %d).\n", status);
+        return;
+    }
+
+    if(!exists){
+        debug("Indexing existing history.\n");
+        status = sqlite3_exec(history->storage, HISTORY_SEARCH_REBUILD, NULL, NULL, NULL);
+        if(status != SQLITE_OK){
+            warn("Cannot index existing history (error %d).\n", status);
+            return;
+        }
+    }
+    history->indexed = TRUE;
+}
+
 static void clip_history_storage_open(ClipboardHistory *history)
 {
     int connect_status = sqlite3_open(clip_config_get_storage_file(), &history->storage);
@@ -103,16 +275,152 @@ static void clip_history_storage_open(ClipboardHistory *history)
     if(SQLITE_OK != create_status){
         warn("Cannot create persistent storage schema (error %d).\n", create_status);
     }
+    clip_history_storage_index(history);
+
+    clip_history_storage_count(history);
+}
+
+static void clip_history_free_pending_event(PendingEvent *pending)
+{
+    clip_clipboard_entry_unref(pending->entry);
+    g_free(pending);
+}
+
+/**
+ * Notifies observers of the event, or queues it until the open batch is committed.
+ */
+static void clip_history_notify(ClipboardHistory *history, ClipboardEvent event, ClipboardEntry *entry)
+{
+    if(history->batch_depth == 0){
+        clip_events_notify(event, entry);
+        return;
+    }
+    PendingEvent *pending = g_malloc(sizeof(PendingEvent));
+    pending->event = event;
+    pending->entry = clip_clipboard_entry_ref(entry);
+    g_queue_push_tail(history->pending_events, pending);
+}
+
+static void clip_history_flush_events(ClipboardHistory *history)
+{
+    // Observers may modify the history, so each event is dequeued before it's delivered.
+    PendingEvent *pending = NULL;
+    while((pending = g_queue_pop_head(history->pending_events)) != NULL){
+        clip_events_notify(pending->event, pending->entry);
+        clip_history_free_pending_event(pending);
+    }
+}
+
+/**
+ * Rolls back the outermost batch and drops its events. Entries removed by the batch are live again.
+ */
+static void clip_history_discard_batch(ClipboardHistory *history)
+{
+    if(!sqlite3_get_autocommit(history->storage)){
+        int status = sqlite3_exec(history->storage, HISTORY_ROLLBACK, NULL, NULL, NULL);
+        if(status != SQLITE_OK){
+            warn("Cannot roll back history transaction (error %d).\n", status);
+        }
+    }
+
+    GQueue added = G_QUEUE_INIT;
+    PendingEvent *pending = NULL;
+    while((pending = g_queue_pop_head(history->pending_events)) != NULL){
+        if(pending->event == CLIPBOARD_REMOVE_EVENT && pending->entry != NULL){
+            clip_history_identity_put(history, pending->entry);
+        } else if(pending->event == CLIPBOARD_ADD_EVENT && pending->entry != NULL){
+            g_queue_push_tail(&added, clip_clipboard_entry_ref(pending->entry));
+        }
+        clip_history_free_pending_event(pending);
+    }
 
+    // Rows inserted by the batch are gone, and SQLite will hand their ids out again.
+    ClipboardEntry *entry = NULL;
+    while((entry = g_queue_pop_head(&added)) != NULL){
+        int64_t id = clip_clipboard_entry_get_id(entry);
+        if(id != 0 && !clip_history_storage_exists(history, id)){
+            debug("Forgetting entry %"PRIu64", which was rolled back.\n", id);
+            if(clip_history_identity_get(history, id) == entry){
+                clip_history_identity_remove(history, id);
+            }
+            clip_clipboard_entry_set_id(entry, 0);
+        }
+        clip_clipboard_entry_unref(entry);
+    }
     clip_history_storage_count(history);
 }
 
+void clip_history_begin(ClipboardHistory *history)
+{
+    if(history->batch_depth++ > 0){
+        return;
+    }
+    history->batch_failed = FALSE;
+    int status = sqlite3_exec(history->storage, HISTORY_BEGIN, NULL, NULL, NULL);
+    if(status != SQLITE_OK){
+        // Without a transaction the batch's statements would each commit on their own, so the batch is failed instead.
+        warn("Cannot begin history transaction (error %d).\n", status);
+        history->batch_failed = TRUE;
+    }
+}
+
+gboolean clip_history_commit(ClipboardHistory *history)
+{
+    if(history->batch_depth < 1){
+        warn("Attempted to commit without a batch.\n");
+        return FALSE;
+    } else if(--history->batch_depth > 0){
+        return !history->batch_failed;
+    } else if(history->batch_failed){
+        debug("Batch failed. Rolling back.\n");
+        clip_history_discard_batch(history);
+        return FALSE;
+    }
+
+    if(!sqlite3_get_autocommit(history->storage)){
+        int status = sqlite3_exec(history->storage, HISTORY_COMMIT, NULL, NULL, NULL);
+        if(status != SQLITE_OK){
+            warn("Cannot commit history transaction (error %d).\n", status);
+            clip_history_discard_batch(history);
+            return FALSE;
+        }
+    }
+    clip_history_flush_events(history);
+    return TRUE;
+}
+
+void clip_history_rollback(ClipboardHistory *history)
+{
+    if(history->batch_depth < 1){
+        warn("Attempted to roll back without a batch.\n");
+        return;
+    }
+    history->batch_failed = TRUE;
+    if(--history->batch_depth == 0){
+        clip_history_discard_batch(history);
+    }
+}
+
+gboolean clip_history_end(ClipboardHistory *history, gboolean success)
+{
+    if(!success){
+        clip_history_rollback(history);
+        return FALSE;
+    }
+    return clip_history_commit(history);
+}
+
 ClipboardHistory* clip_history_new()
 {
     ClipboardHistory *history = g_malloc(sizeof(ClipboardHistory));
     history->storage = NULL;
     history->count = 0;
+    history->indexed = FALSE;
     history->observers = NULL;
+    history->entries = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+    history->batch_depth = 0;
+    history->batch_failed = FALSE;
+    history->pending_events = g_queue_new();
 
     clip_history_storage_open(history);
 
@@ -130,22 +438,89 @@ void clip_history_free(ClipboardHistory *history)
         g_list_free(history->observers);
         history->observers = NULL;
     }
+    // Entries may outlive the history.
+    g_hash_table_foreach(history->entries, (GHFunc)clip_history_cb_forget_entry, NULL);
+    g_hash_table_destroy(history->entries);
+    history->entries = NULL;
+    g_queue_free_full(history->pending_events, (GDestroyNotify)clip_history_free_pending_event);
+    history->pending_events = NULL;
     g_free(history);
 }
 
-void clip_history_free_list(GList *list)
+static void clip_history_free_list(GList *list)
+{
+    g_list_free_full(list, (GDestroyNotify)clip_clipboard_entry_unref);
+}
+
+/**
+ * Prepares a statement that writes to the history. Writes are refused once the enclosing batch has failed, since its
+ * transaction may not exist and the write would otherwise commit on its own.
+ */
+static int clip_history_prepare_write(ClipboardHistory *history, const char *query, sqlite3_stmt **statement)
 {
-    g_list_free_full(list, (GDestroyNotify)clip_clipboard_entry_free);
+    if(history->batch_depth > 0 && history->batch_failed){
+        *statement = NULL;
+        return SQLITE_ABORT;
+    }
+    return sqlite3_prepare(history->storage, query, -1, statement, NULL);
+}
+
+/**
+ * Runs a query that selects a single id, returning 0 if there is no such row.
+ */
+static int64_t clip_history_select_id(ClipboardHistory *history, const char *query)
+{
+    int64_t id = 0;
+    sqlite3_stmt *statement = NULL;
+    int status = sqlite3_prepare(history->storage, query, -1, &statement, NULL);
+    if(status != SQLITE_OK){
+        warn("Cannot prepare id selection query (error %d).\n", status);
+    } else if(sqlite3_step(statement) == SQLITE_ROW){
+        id = sqlite3_column_int64(statement, 0);
+    }
+    sqlite3_finalize(statement);
+    return id;
+}
+
+/**
+ * Deletes the unlocked row with the specified id. If a row was deleted, its live entry is dropped from the identity
+ * map and observers are notified.
+ */
+static gboolean clip_history_remove_by_id(ClipboardHistory *history, int64_t id)
+{
+    gboolean success = TRUE;
+    sqlite3_stmt *statement = NULL;
+
+    trace("Removing clipboard entry %"PRIu64".\n", id);
+    int status = clip_history_prepare_write(history, HISTORY_DELETE_UNLOCKED_BY_ID, &statement);
+    if(status == SQLITE_OK){
+        sqlite3_bind_int64(statement, 1, id);
+        if((status = sqlite3_step(statement)) != SQLITE_DONE){
+            warn("Couldn't remove entry, %"PRIu64" (error %d).\n", id, status);
+            success = FALSE;
+        } else if(sqlite3_changes(history->storage) > 0){
+            history->count--;
+            ClipboardEntry *entry = clip_clipboard_entry_ref(clip_history_identity_get(history, id));
+            clip_history_identity_remove(history, id);
+            if(entry != NULL){
+                clip_history_notify(history, CLIPBOARD_REMOVE_EVENT, entry);
+            }
+            clip_clipboard_entry_unref(entry);
+        }
+    } else {
+        warn("Couldn't prepare entry removal query for %"PRIu64" (error %d).\n", id, status);
+        success = FALSE;
+    }
+    sqlite3_finalize(statement);
+    return success;
 }
 
 static void clip_history_evict(ClipboardHistory *history)
 {
-    int status = sqlite3_exec(history->storage, HISTORY_EVICT_SINGLE, NULL, NULL, NULL);
-    if(SQLITE_OK != status){
-        warn("Cannot remove oldest history record (error %d).\n", status);
-        return;
+    int64_t id = clip_history_select_id(history, HISTORY_SELECT_EVICTABLE);
+    if(id == 0 || !clip_history_remove_by_id(history, id)){
+        warn("Cannot remove oldest history record.\n");
     }
-    history->count -= sqlite3_changes(history->storage);
 }
 
 
@@ -154,12 +529,13 @@ static gboolean clip_history_prepend_new(ClipboardHistory *history, ClipboardEnt
 {
     gboolean success = TRUE;
     sqlite3_stmt *statement = NULL;
-    char *text = clip_clipboard_entry_get_text(entry);
+    ClipboardText *text = clip_clipboard_entry_get_text_buffer(entry);
 
     trace("Prepending new entry.\n");
-    int status = sqlite3_prepare(history->storage, HISTORY_INSERT_NEW, -1, &statement, NULL);
+    int status = clip_history_prepare_write(history, HISTORY_INSERT_NEW, &statement);
     if(status == SQLITE_OK){
-        sqlite3_bind_text(statement, 1, text, -1, SQLITE_TRANSIENT);
+        clip_history_bind_text(statement, 1, text);
+        sqlite3_bind_int(statement, 2, clip_clipboard_entry_is_masked(entry));
         if((status = sqlite3_step(statement)) == SQLITE_DONE){
             int64_t id = sqlite3_last_insert_rowid(history->storage);
             clip_clipboard_entry_set_id(entry, id);
@@ -181,12 +557,12 @@ static gboolean clip_history_prepend_existing(ClipboardHistory *history, Clipboa
     gboolean success = TRUE;
     sqlite3_stmt *statement = NULL;
     int64_t id = clip_clipboard_entry_get_id(entry);
-    char *text = clip_clipboard_entry_get_text(entry);
+    ClipboardText *text = clip_clipboard_entry_get_text_buffer(entry);
 
     trace("Promoting existing entry, %"PRIu64", to top.\n", id);
-    int status = sqlite3_prepare(history->storage, HISTORY_INSERT_EXISTING, -1, &statement, NULL);
+    int status = clip_history_prepare_write(history, HISTORY_INSERT_EXISTING, &statement);
     if(status == SQLITE_OK){
-        sqlite3_bind_text(statement, 1, text, -1, SQLITE_TRANSIENT);
+        clip_history_bind_text(statement, 1, text);
         sqlite3_bind_int(statement, 2, clip_clipboard_entry_is_masked(entry));
         sqlite3_bind_int64(statement, 3, id);
         if((status = sqlite3_step(statement)) != SQLITE_DONE){
@@ -202,33 +578,61 @@ static gboolean clip_history_prepend_existing(ClipboardHistory *history, Clipboa
 }
 
 /**
- * Creates and returns a new history entry. Invokers are responsible for freeing it.
+ * Returns a reference to the live entry for the persisted entry, adopting the entry itself if there isn't one yet.
  */
-gboolean clip_history_prepend(ClipboardHistory *history, ClipboardEntry *entry)
+static ClipboardEntry* clip_history_canonicalize(ClipboardHistory *history, ClipboardEntry *entry)
+{
+    ClipboardEntry *canonical = clip_history_identity_get(history, clip_clipboard_entry_get_id(entry));
+    if(canonical == NULL){
+        clip_history_identity_put(history, entry);
+        canonical = entry;
+    } else if(canonical != entry){
+        // The same row was persisted through another object (e.g. a new entry replaced an existing one by text). The row
+        // is masked if either was.
+        clip_clipboard_entry_set_text(canonical, clip_clipboard_entry_get_text_buffer(entry));
+        if(clip_clipboard_entry_is_masked(entry) && !clip_clipboard_entry_is_masked(canonical)){
+            clip_clipboard_entry_set_masked(canonical, TRUE);
+        }
+    }
+    return clip_clipboard_entry_ref(canonical);
+}
+
+/**
+ * Persists the entry as the newest history entry. Returns a reference to the history's live entry for the record,
+ * which may not be the entry provided (e.g. when a new entry's text is already in the history). Invokers are
+ * responsible for releasing it. Returns NULL on failure.
+ */
+ClipboardEntry* clip_history_prepend(ClipboardHistory *history, ClipboardEntry *entry)
 {
     if(clip_clipboard_entry_get_text(entry) == NULL){
         error("Refusing to persist a null entry.");
-        return FALSE;
+        return NULL;
     }
 
     gboolean success;
+    clip_history_begin(history);
     if(clip_clipboard_entry_is_new(entry)){
         success = clip_history_prepend_new(history, entry);
     } else {
         success = clip_history_prepend_existing(history, entry);
     }
 
+    ClipboardEntry *canonical = success ? clip_history_canonicalize(history, entry) : NULL;
+
     // Reacquire the new count (an insert may have been a replace).
     clip_history_storage_count(history);
     if(history->count > HISTORY_MAX_SIZE){
         clip_history_evict(history);
     }
 
-    if(success){
-        clip_events_notify(CLIPBOARD_ADD_EVENT, entry);
-        return TRUE;
+    if(canonical != NULL){
+        clip_history_notify(history, CLIPBOARD_ADD_EVENT, canonical);
     }
-    return FALSE;
+    if(!clip_history_end(history, success)){
+        clip_clipboard_entry_unref(canonical);
+        canonical = NULL;
+    }
+    return canonical;
 }
 
 /**
@@ -240,7 +644,7 @@ static gboolean clip_history_remove_duplicates(ClipboardHistory *history, Clipbo
 {
     gboolean success = TRUE;
     int64_t id = clip_clipboard_entry_get_id(entry);
-    ClipboardEntry *existing = clip_history_get_by_text(history, clip_clipboard_entry_get_text(entry));
+    ClipboardEntry *existing = clip_history_get_by_text(history, clip_clipboard_entry_get_text_buffer(entry));
     if(existing != NULL && !clip_clipboard_entry_same(entry, existing)){
         debug("Entry, %"PRIu64", already has that value.\n", id);
         if(!clip_history_remove(history, existing)){
@@ -248,14 +652,14 @@ static gboolean clip_history_remove_duplicates(ClipboardHistory *history, Clipbo
             success = FALSE;
         }
     }
-    clip_clipboard_entry_free(existing);
+    clip_clipboard_entry_unref(existing);
     return success;
 }
 
 
 gboolean clip_history_update(ClipboardHistory *history, ClipboardEntry *entry)
 {
-    char *text = clip_clipboard_entry_get_text(entry);
+    ClipboardText *text = clip_clipboard_entry_get_text_buffer(entry);
     if(text == NULL){
         error("Refusing to update a null entry.");
         return FALSE;
@@ -263,6 +667,7 @@ gboolean clip_history_update(ClipboardHistory *history, ClipboardEntry *entry)
 
     gboolean success = TRUE;
     int64_t id = clip_clipboard_entry_get_id(entry);
+    clip_history_begin(history);
     if (!clip_history_remove_duplicates(history, entry)) {
         success = FALSE;
         goto exit;
@@ -270,10 +675,10 @@ gboolean clip_history_update(ClipboardHistory *history, ClipboardEntry *entry)
 
     sqlite3_stmt *statement = NULL;
     trace("Updating existing entry, %"PRIu64".\n", id);
-    int status = sqlite3_prepare(history->storage, HISTORY_UPDATE_BY_ID, -1, &statement, NULL);
+    int status = clip_history_prepare_write(history, HISTORY_UPDATE_BY_ID, &statement);
     if(status == SQLITE_OK){
         char tag = clip_clipboard_entry_get_tag(entry);
-        sqlite3_bind_text(statement, 1, text, -1, SQLITE_TRANSIENT);
+        clip_history_bind_text(statement, 1, text);
         sqlite3_bind_int(statement, 2, clip_clipboard_entry_get_locked(entry));
         sqlite3_bind_text(statement, 3, tag == 0 ? NULL : &tag, 1, SQLITE_TRANSIENT);
         sqlite3_bind_int(statement, 4, clip_clipboard_entry_is_masked(entry));
@@ -282,7 +687,7 @@ gboolean clip_history_update(ClipboardHistory *history, ClipboardEntry *entry)
             warn("Couldn't update entry, %"PRIu64" (error %d).\n", id, status);
             success = FALSE;
         } else {
-            clip_events_notify(CLIPBOARD_UPDATE_EVENT, entry);
+            clip_history_notify(history, CLIPBOARD_UPDATE_EVENT, entry);
         }
     } else {
         warn("Couldn't prepare entry update for %"PRIu64" (error %d).\n", id, status);
@@ -290,109 +695,379 @@ gboolean clip_history_update(ClipboardHistory *history, ClipboardEntry *entry)
     }
     sqlite3_finalize(statement);
 exit:
-    return success;
+    return clip_history_end(history, success);
 }
 
+/**
+ * Prepares a single column update, returning NULL on failure.
+ */
+static sqlite3_stmt* clip_history_prepare_column_update(ClipboardHistory *history, const char *query)
+{
+    sqlite3_stmt *statement = NULL;
+    int status = clip_history_prepare_write(history, query, &statement);
+    if(status != SQLITE_OK){
+        warn("Couldn't prepare column update (error %d).\n", status);
+        sqlite3_finalize(statement);
+        return NULL;
+    }
+    return statement;
+}
 
 /**
- * Removes the entry from the history. This function does not free the entry, just removes it from the backing store.
+ * Runs a prepared single column update for the entry. The new value must already be bound as the first parameter.
+ * The statement is finalized.
  */
-gboolean clip_history_remove(ClipboardHistory *history, ClipboardEntry *entry)
+static gboolean clip_history_update_column(ClipboardHistory *history, ClipboardEntry *entry, sqlite3_stmt *statement)
 {
+    if(statement == NULL){
+        return FALSE;
+    }
+
     gboolean success = TRUE;
-    sqlite3_stmt *statement = NULL;
     int64_t id = clip_clipboard_entry_get_id(entry);
-
-    trace("Removing clipboard entry %"PRIu64".\n", id);
-    int status = sqlite3_prepare(history->storage, HISTORY_DELETE_UNLOCKED_BY_ID, -1, &statement, NULL);
-    if(status == SQLITE_OK){
-        sqlite3_bind_int64(statement, 1, id);
-        if(sqlite3_step(statement) != SQLITE_DONE){
-            warn("Couldn't remove entry, %"PRIu64" (error %d).\n", id, status);
-            success = FALSE;
-        } else {
-            clip_events_notify(CLIPBOARD_REMOVE_EVENT, entry);
-        }
-    } else {
-        warn("Couldn't prepare entry removal query for %"PRIu64" (error %d).\n", id, status);
+    trace("Updating column of existing entry, %"PRIu64".\n", id);
+    sqlite3_bind_int64(statement, 2, id);
+    int status = sqlite3_step(statement);
+    if(status != SQLITE_DONE){
+        warn("Couldn't update entry, %"PRIu64" (error %d).\n", id, status);
+        success = FALSE;
+    } else if(sqlite3_changes(history->storage) == 0){
+        // The entry was deleted while it was held, or was never saved.
+        warn("Couldn't update entry, %"PRIu64", which isn't in the history.\n", id);
         success = FALSE;
+    } else {
+        clip_history_notify(history, CLIPBOARD_UPDATE_EVENT, entry);
     }
     sqlite3_finalize(statement);
     return success;
 }
 
+gboolean clip_history_update_locked(ClipboardHistory *history, ClipboardEntry *entry)
+{
+    sqlite3_stmt *statement = clip_history_prepare_column_update(history, HISTORY_UPDATE_LOCKED_BY_ID);
+    if(statement != NULL){
+        sqlite3_bind_int(statement, 1, clip_clipboard_entry_get_locked(entry));
+    }
+    return clip_history_update_column(history, entry, statement);
+}
+
+gboolean clip_history_update_masked(ClipboardHistory *history, ClipboardEntry *entry)
+{
+    sqlite3_stmt *statement = clip_history_prepare_column_update(history, HISTORY_UPDATE_MASKED_BY_ID);
+    if(statement != NULL){
+        sqlite3_bind_int(statement, 1, clip_clipboard_entry_is_masked(entry));
+    }
+    return clip_history_update_column(history, entry, statement);
+}
+
+gboolean clip_history_update_tag(ClipboardHistory *history, ClipboardEntry *entry)
+{
+    sqlite3_stmt *statement = clip_history_prepare_column_update(history, HISTORY_UPDATE_TAG_BY_ID);
+    if(statement != NULL){
+        char tag = clip_clipboard_entry_get_tag(entry);
+        sqlite3_bind_text(statement, 1, tag == 0 ? NULL : &tag, 1, SQLITE_TRANSIENT);
+    }
+    return clip_history_update_column(history, entry, statement);
+}
+
+
+/**
+ * Removes the entry from the history. This function does not free the entry, just removes it from the backing store.
+ */
+gboolean clip_history_remove(ClipboardHistory *history, ClipboardEntry *entry)
+{
+    return clip_history_remove_by_id(history, clip_clipboard_entry_get_id(entry));
+}
+
 gboolean clip_history_remove_head(ClipboardHistory *history)
 {
-    gboolean success = TRUE;
-    int status = sqlite3_exec(history->storage, HISTORY_DELETE_UNLOCKED_BY_AGE, NULL, NULL, NULL);
-    if(SQLITE_OK != status){
-        warn("Cannot remove newest history record (error %d).\n", status);
-        success = FALSE;
+    int64_t id = clip_history_select_id(history, HISTORY_SELECT_NEWEST_UNLOCKED);
+    if(id == 0){
+        return TRUE;
+    } else if(!clip_history_remove_by_id(history, id)){
+        warn("Cannot remove newest history record.\n");
+        return FALSE;
     }
-    history->count -= sqlite3_changes(history->storage);
-    return success;
+    return TRUE;
+}
+
+static gboolean clip_history_is_entry_unlocked(gpointer id, ClipboardEntry *entry, gpointer user_data)
+{
+    if(clip_clipboard_entry_get_locked(entry)){
+        return FALSE;
+    }
+    clip_history_identity_forget(entry);
+    return TRUE;
 }
 
 void clip_history_clear(ClipboardHistory *history)
 {
+    if(history->batch_depth > 0 && history->batch_failed){
+        warn("Refusing to truncate history in a failed batch.\n");
+        return;
+    }
     int status = sqlite3_exec(history->storage, HISTORY_CLEAR, NULL, NULL, NULL);
     if(SQLITE_OK != status){
         warn("Cannot truncate history table (error %d).\n", status);
     } else {
-        clip_events_notify(CLIPBOARD_CLEAR_EVENT, NULL);
+        g_hash_table_foreach_remove(history->entries, (GHRFunc)clip_history_is_entry_unlocked, NULL);
+        clip_history_notify(history, CLIPBOARD_CLEAR_EVENT, NULL);
     }
     history->count -= sqlite3_changes(history->storage);
 }
 
 
-static ClipboardEntry* clip_history_entry_for_row(sqlite3_stmt *statement)
+/**
+ * Returns a reference to the live entry for the current row, creating it if it isn't already live.
+ */
+static ClipboardEntry* clip_history_entry_for_row(ClipboardHistory *history, sqlite3_stmt *statement)
 {
     int64_t id = sqlite3_column_int64(statement, 0);
-    char *text = (char*)sqlite3_column_text(statement, 1);
+    ClipboardEntry *live = clip_history_identity_get(history, id);
+    if(live != NULL){
+        return clip_clipboard_entry_ref(live);
+    }
+
+    const char *str = (const char*)sqlite3_column_text(statement, 1);
+    ClipboardText *text = clip_clipboard_text_new(str, sqlite3_column_bytes(statement, 1));
     gboolean locked = sqlite3_column_int(statement, 2);
     int count = sqlite3_column_int(statement, 3);
     char *tag = (char*)sqlite3_column_text(statement, 4);
     gboolean masked = sqlite3_column_int(statement, 5);
-    return clip_clipboard_entry_new(id, text, locked, count, tag == NULL ? 0 : tag[0], masked);
+    ClipboardEntry *entry = clip_clipboard_entry_new(id, text, locked, count, tag == NULL ? 0 : tag[0], masked);
+    clip_clipboard_text_unref(text);
+    clip_history_identity_put(history, entry);
+    return entry;
 }
 
-GList* clip_history_get_list(ClipboardHistory *history)
+/**
+ * Returns up to limit of the newest entries, newest first.
+ */
+static GList* clip_history_get_recent(ClipboardHistory *history, int limit)
 {
     GList *list = NULL;
     sqlite3_stmt *statement = NULL;
-    int status = sqlite3_prepare(history->storage, HISTORY_SELECT_ALL, -1, &statement, NULL);
+    int status = sqlite3_prepare(history->storage, HISTORY_SELECT_RECENT, -1, &statement, NULL);
     if(status != SQLITE_OK){
         warn("Cannot prepare history selection query (error %d).\n", status);
     } else {
+        sqlite3_bind_int(statement, 1, limit);
         while(sqlite3_step(statement) == SQLITE_ROW){
-            list = g_list_prepend(list, clip_history_entry_for_row(statement));
+            list = g_list_prepend(list, clip_history_entry_for_row(history, statement));
         }
     }
     sqlite3_finalize(statement);
-    return list;
+    return g_list_reverse(list);
+}
+
+/**
+ * Appends every row selected by the statement to the snapshot. Rows must be selected as id, text, locked, tag, masked.
+ */
+static void clip_history_snapshot_fill(ClipboardHistorySnapshot *snapshot, sqlite3_stmt *statement)
+{
+    while(sqlite3_step(statement) == SQLITE_ROW){
+        const char *text = (const char*)sqlite3_column_text(statement, 1);
+        gsize length = sqlite3_column_bytes(statement, 1);
+        const char *tag = (const char*)sqlite3_column_text(statement, 3);
+        clip_history_snapshot_append(snapshot, sqlite3_column_int64(statement, 0), text == NULL ? "" : text, length,
+                sqlite3_column_int(statement, 2), sqlite3_column_int(statement, 4), tag == NULL ? 0 : tag[0]);
+    }
+}
+
+ClipboardHistorySnapshot* clip_history_get_snapshot(ClipboardHistory *history)
+{
+    guint capacity = MAX(history->count, 0);
+    ClipboardHistorySnapshot *snapshot = clip_history_snapshot_new(capacity, capacity * HISTORY_SNAPSHOT_ROW_TEXT_SIZE);
+    sqlite3_stmt *statement = NULL;
+    int status = sqlite3_prepare(history->storage, HISTORY_SELECT_SNAPSHOT, -1, &statement, NULL);
+    if(status != SQLITE_OK){
+        warn("Cannot prepare history snapshot query (error %d).\n", status);
+    } else {
+        clip_history_snapshot_fill(snapshot, statement);
+    }
+    sqlite3_finalize(statement);
+    return snapshot;
+}
+
+/**
+ * Determines if the term can be found through the index. The index holds trigrams, so shorter terms can't be.
+ */
+static gboolean clip_history_is_searchable(ClipboardHistory *history, const char *term)
+{
+    return history->indexed && g_utf8_strlen(term, -1) >= HISTORY_SEARCH_MIN_LENGTH;
+}
+
+/**
+ * Quotes the term as an FTS5 string, so that it's matched as a substring rather than parsed as a query.
+ */
+static char* clip_history_quote_term(const char *term)
+{
+    GString *quoted = g_string_new("\"");
+    for(const char *c = term; *c != '\0'; c++){
+        if(*c == '"'){
+            g_string_append_c(quoted, '"');
+        }
+        g_string_append_c(quoted, *c);
+    }
+    g_string_append_c(quoted, '"');
+    return g_string_free(quoted, FALSE);
+}
+
+GList* clip_history_search(ClipboardHistory *history, const char *term, int limit)
+{
+    gboolean searchable = clip_history_is_searchable(history, term);
+    char *quoted = searchable ? clip_history_quote_term(term) : NULL;
+    GList *list = NULL;
+
+    sqlite3_stmt *statement = NULL;
+    int status = sqlite3_prepare(history->storage, searchable ? HISTORY_SELECT_MATCHING : HISTORY_SELECT_CONTAINING, -1,
+            &statement, NULL);
+    if(status != SQLITE_OK){
+        warn("Cannot prepare history search query (error %d).\n", status);
+    } else {
+        sqlite3_bind_text(statement, 1, searchable ? quoted : term, -1, SQLITE_STATIC);
+        sqlite3_bind_int(statement, 2, limit);
+        while(sqlite3_step(statement) == SQLITE_ROW){
+            list = g_list_prepend(list, clip_history_entry_for_row(history, statement));
+        }
+    }
+    sqlite3_finalize(statement);
+    g_free(quoted);
+    trace("Found %u entries containing '%s'%s.\n", g_list_length(list), term, searchable ? "" : " by scanning");
+    return g_list_reverse(list);
+}
+
+GArray* clip_history_search_ids(ClipboardHistory *history, const char *term)
+{
+    if(!clip_history_is_searchable(history, term)){
+        return NULL;
+    }
+
+    GArray *ids = NULL;
+    char *quoted = clip_history_quote_term(term);
+    sqlite3_stmt *statement = NULL;
+    int status = sqlite3_prepare(history->storage, HISTORY_SELECT_MATCHING_IDS, -1, &statement, NULL);
+    if(status != SQLITE_OK){
+        warn("Cannot prepare history search query (error %d).\n", status);
+        goto exit;
+    }
+
+    sqlite3_bind_text(statement, 1, quoted, -1, SQLITE_STATIC);
+    ids = g_array_new(FALSE, FALSE, sizeof(int64_t));
+    while((status = sqlite3_step(statement)) == SQLITE_ROW){
+        int64_t id = sqlite3_column_int64(statement, 0);
+        g_array_append_val(ids, id);
+    }
+    if(status != SQLITE_DONE){
+        warn("Cannot search history (error %d).\n", status);
+        g_array_free(ids, TRUE);
+        ids = NULL;
+    }
+
+exit:
+    sqlite3_finalize(statement);
+    g_free(quoted);
+    return ids;
+}
+
+/**
+ * Returns a reference to the entry selected by a single row query, or NULL if there's no such row. The statement's
+ * parameters must already be bound. The statement is finalized.
+ */
+static ClipboardEntry* clip_history_select_entry(ClipboardHistory *history, sqlite3_stmt *statement)
+{
+    ClipboardEntry *entry = NULL;
+    if(statement != NULL && sqlite3_step(statement) == SQLITE_ROW){
+        entry = clip_history_entry_for_row(history, statement);
+    }
+    sqlite3_finalize(statement);
+    return entry;
+}
+
+/**
+ * Prepares a single row query, returning NULL on failure.
+ */
+static sqlite3_stmt* clip_history_prepare_select(ClipboardHistory *history, const char *query)
+{
+    sqlite3_stmt *statement = NULL;
+    int status = sqlite3_prepare(history->storage, query, -1, &statement, NULL);
+    if(status != SQLITE_OK){
+        warn("Cannot prepare entry query (error %d).\n", status);
+        sqlite3_finalize(statement);
+        return NULL;
+    }
+    return statement;
+}
+
+ClipboardEntry* clip_history_get_entry(ClipboardHistory *history, int64_t id)
+{
+    ClipboardEntry *live = clip_history_identity_get(history, id);
+    if(live != NULL){
+        return clip_clipboard_entry_ref(live);
+    }
+
+    sqlite3_stmt *statement = clip_history_prepare_select(history, HISTORY_SELECT_BY_ID);
+    if(statement != NULL){
+        sqlite3_bind_int64(statement, 1, id);
+    }
+    return clip_history_select_entry(history, statement);
+}
+
+ClipboardEntry* clip_history_get_tagged(ClipboardHistory *history, char tag)
+{
+    if(tag == 0){
+        return NULL;
+    }
+    sqlite3_stmt *statement = clip_history_prepare_select(history, HISTORY_SELECT_BY_TAG);
+    if(statement != NULL){
+        sqlite3_bind_text(statement, 1, &tag, 1, SQLITE_TRANSIENT);
+    }
+    return clip_history_select_entry(history, statement);
+}
+
+ClipboardEntry* clip_history_get_nth(ClipboardHistory *history, guint n)
+{
+    sqlite3_stmt *statement = clip_history_prepare_select(history, HISTORY_SELECT_NTH);
+    if(statement != NULL){
+        sqlite3_bind_int64(statement, 1, n);
+    }
+    return clip_history_select_entry(history, statement);
+}
+
+ClipboardEntry* clip_history_get_next(ClipboardHistory *history, ClipboardEntry *entry)
+{
+    sqlite3_stmt *statement = clip_history_prepare_select(history, HISTORY_SELECT_NEXT);
+    if(statement != NULL){
+        sqlite3_bind_int64(statement, 1, clip_clipboard_entry_get_id(entry));
+    }
+    return clip_history_select_entry(history, statement);
 }
 
 ClipboardEntry* clip_history_get_head(ClipboardHistory *history)
 {
     ClipboardEntry *head = NULL;
-    GList *list = clip_history_get_list(history);
+    GList *list = clip_history_get_recent(history, 1);
     if(list == NULL){
         goto exit;
     }
-    head = clip_clipboard_entry_clone(g_list_first(list)->data);
+    head = clip_clipboard_entry_ref(g_list_first(list)->data);
 exit:
     clip_history_free_list(list);
     return head;
 }
 
 
-static gboolean clip_history_levenshtein_similar(char *left, char *right) {
-    int distance = levenshtein_distance(left, right);
-    int shortest = MIN(strlen(left), strlen(right));
+static gboolean clip_history_levenshtein_similar(ClipboardText *left, ClipboardText *right) {
+    int left_length = clip_clipboard_text_get_length(left);
+    int right_length = clip_clipboard_text_get_length(right);
+    const char *left_str = clip_clipboard_text_get_str(left);
+    const char *right_str = clip_clipboard_text_get_str(right);
+    int distance = levenshtein_distance(left_str, left_length, right_str, right_length);
+    int shortest = MIN(left_length, right_length);
     // Magic numbers. These are an arbitrary crapshoot, anyways.
     int threshold = shortest / 100 + 3;
     if(distance < threshold){
-        trace("Distance of [%s] and [%s] is %d.\n", left, right, distance);
+        trace("Distance of [%s] and [%s] is %d.\n", left_str, right_str, distance);
         return TRUE;
     }
     return FALSE;
@@ -405,9 +1080,9 @@ ClipboardEntry* clip_history_get_similar(ClipboardHistory *history, ClipboardEnt
     }
 
     ClipboardEntry *matching = NULL;
-    GList *list = clip_history_get_list(history);
+    GList *list = clip_history_get_recent(history, limit_scan);
     GList *next = g_list_first(list);
-    char *left = clip_clipboard_entry_get_text(entry);
+    ClipboardText *left = clip_clipboard_entry_get_text_buffer(entry);
     if(left == NULL){
         warn("New entry has no text.\n");
         goto exit;
@@ -421,7 +1096,7 @@ ClipboardEntry* clip_history_get_similar(ClipboardHistory *history, ClipboardEnt
             goto next;
         }
 
-        char *right = clip_clipboard_entry_get_text(next_entry);
+        ClipboardText *right = clip_clipboard_entry_get_text_buffer(next_entry);
         if(right == NULL){
             warn("Historic entry has null text.\n");
             goto exit;
@@ -429,7 +1104,7 @@ ClipboardEntry* clip_history_get_similar(ClipboardHistory *history, ClipboardEnt
 
         gboolean found_similar = clip_history_levenshtein_similar(left, right);
         if(found_similar){
-            matching = clip_clipboard_entry_clone(next_entry);
+            matching = clip_clipboard_entry_ref(next_entry);
             break;
         }
 next:
@@ -444,7 +1119,7 @@ exit:
 
 
 
-static ClipboardEntry* clip_history_get_by_text(ClipboardHistory *history, char *text)
+static ClipboardEntry* clip_history_get_by_text(ClipboardHistory *history, ClipboardText *text)
 {
     ClipboardEntry *entry = NULL;
     sqlite3_stmt *statement = NULL;
@@ -452,9 +1127,9 @@ static ClipboardEntry* clip_history_get_by_text(ClipboardHistory *history, char
     if(status != SQLITE_OK){
         warn("Cannot prepare query for text (error %d).\n", status);
     } else {
-        sqlite3_bind_text(statement, 1, text, -1, SQLITE_TRANSIENT);
+        clip_history_bind_text(statement, 1, text);
         if(sqlite3_step(statement) == SQLITE_ROW){
-            entry = clip_history_entry_for_row(statement);
+            entry = clip_history_entry_for_row(history, statement);
         }
     }
     sqlite3_finalize(statement);
@@ -464,10 +1139,10 @@ static ClipboardEntry* clip_history_get_by_text(ClipboardHistory *history, char
 /**
  * No author specified. See http://rosettacode.org/wiki/Levenshtein_distance#C.
  */
-static int levenshtein_distance(const char *s, const char *t)
+static int levenshtein_distance(const char *s, int ls, const char *t, int lt)
 {
-    int ls = MIN(1024, strlen(s));
-    int lt = MIN(1024, strlen(t));
+    ls = MIN(1024, ls);
+    lt = MIN(1024, lt);
     int *d = g_malloc((ls + 1) * (lt + 1) * sizeof(int));
     for (int i = 0; i <= ls; i++){
         for (int j = 0; j <= lt; j++){
@@ -20,6 +20,7 @@
  */
 
 #include "clipboard_entry.h"
+#include "history_snapshot.h"
 
 #include <glib.h>
 
@@ -27,16 +28,68 @@ typedef struct history ClipboardHistory;
 
 ClipboardHistory* clip_history_new(void);
 void clip_history_free(ClipboardHistory *history);
-void clip_history_free_list(GList *list);
 
-gboolean clip_history_prepend(ClipboardHistory *history, ClipboardEntry *entry);
+/**
+ * Batches group compound changes into one atomic commit. Batches nest; only the outermost commit writes, and events
+ * raised within the batch are delivered after it commits. If any nested batch rolls back, the whole batch is rolled
+ * back and its events are dropped.
+ */
+void clip_history_begin(ClipboardHistory *history);
+gboolean clip_history_commit(ClipboardHistory *history);
+void clip_history_rollback(ClipboardHistory *history);
+/**
+ * Commits the batch if success is TRUE, otherwise rolls it back. Returns whether the batch was committed.
+ */
+gboolean clip_history_end(ClipboardHistory *history, gboolean success);
+
+ClipboardEntry* clip_history_prepend(ClipboardHistory *history, ClipboardEntry *entry);
 gboolean clip_history_update(ClipboardHistory *history, ClipboardEntry *entry);
+/**
+ * Persist a single flag of the entry. Unlike clip_history_update, the text is neither compared nor rewritten.
+ */
+gboolean clip_history_update_locked(ClipboardHistory *history, ClipboardEntry *entry);
+gboolean clip_history_update_masked(ClipboardHistory *history, ClipboardEntry *entry);
+gboolean clip_history_update_tag(ClipboardHistory *history, ClipboardEntry *entry);
 
 gboolean clip_history_remove(ClipboardHistory *history, ClipboardEntry *entry);
 gboolean clip_history_remove_head(ClipboardHistory *history);
 void clip_history_clear(ClipboardHistory *history);
 
-GList* clip_history_get_list(ClipboardHistory *history);
+/**
+ * Returns a snapshot of the whole history, newest first. The snapshot must be released when no longer used.
+ */
+ClipboardHistorySnapshot* clip_history_get_snapshot(ClipboardHistory *history);
+/**
+ * Returns references to the live entries containing the term, ignoring case, newest first. At most limit entries are
+ * returned, or all of them if limit is negative. Terms of three or more characters are found through the full-text
+ * index; shorter terms are found by scanning the history. Free the list with g_list_free_full and
+ * clip_clipboard_entry_unref.
+ */
+GList* clip_history_search(ClipboardHistory *history, const char *term, int limit);
+/**
+ * Returns the ids of every entry containing the term, ignoring case, in no particular order. Returns NULL if the term
+ * can't be found through the full-text index, in which case the caller must scan for it.
+ */
+GArray* clip_history_search_ids(ClipboardHistory *history, const char *term);
+/**
+ * Returns a reference to the live entry for the specified id, loading it if needed. Returns NULL if there is no such
+ * entry.
+ */
+ClipboardEntry* clip_history_get_entry(ClipboardHistory *history, int64_t id);
+/**
+ * Returns a reference to the live entry holding the tag, or NULL if no entry holds it.
+ */
+ClipboardEntry* clip_history_get_tagged(ClipboardHistory *history, char tag);
+/**
+ * Returns a reference to the live entry n rows down the history, where row 0 is the newest entry. Returns NULL if the
+ * history is shorter than that.
+ */
+ClipboardEntry* clip_history_get_nth(ClipboardHistory *history, guint n);
+/**
+ * Returns a reference to the live entry in the row below the entry, or NULL if the entry is the oldest or isn't in the
+ * history.
+ */
+ClipboardEntry* clip_history_get_next(ClipboardHistory *history, ClipboardEntry *entry);
 ClipboardEntry* clip_history_get_head(ClipboardHistory *history);
 ClipboardEntry* clip_history_get_similar(ClipboardHistory *history, ClipboardEntry *entry, int limit_scan);
 
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "history_snapshot.h"
+#include "utils.h"
+
+#include <string.h>
+
+#define SNAPSHOT_LOCKED 0x1
+#define SNAPSHOT_MASKED 0x2
+
+struct history_snapshot {
+    gint refs;
+    guint length;
+    guint capacity;
+    // Each array holds capacity elements; offsets holds one more so that a row's length is the gap to the next.
+    int64_t *ids;
+    gsize *offsets;
+    guint8 *flags;
+    char *tags;
+    char *arena;
+    gsize arena_size;
+    // The row holding each tag, or -1. Tags are unique within the history.
+    gint tag_rows[256];
+};
+
+
+/**
+ * Places the row arrays in the same allocation as the snapshot itself, widest types first to keep them aligned.
+ */
+static void clip_history_snapshot_layout(ClipboardHistorySnapshot *snapshot, char *rows, guint capacity)
+{
+    snapshot->capacity = capacity;
+    snapshot->ids = (int64_t*)rows;
+    snapshot->offsets = (gsize*)(snapshot->ids + capacity);
+    snapshot->flags = (guint8*)(snapshot->offsets + capacity + 1);
+    snapshot->tags = (char*)(snapshot->flags + capacity);
+}
+
+static gboolean clip_history_snapshot_has_inline_rows(ClipboardHistorySnapshot *snapshot)
+{
+    return (char*)snapshot->ids == (char*)(snapshot + 1);
+}
+
+static gsize clip_history_snapshot_rows_size(guint capacity)
+{
+    return capacity * (sizeof(int64_t) + sizeof(gsize) + sizeof(guint8) + sizeof(char)) + sizeof(gsize);
+}
+
+ClipboardHistorySnapshot* clip_history_snapshot_new(guint capacity, gsize text_size)
+{
+    ClipboardHistorySnapshot *snapshot = g_malloc(sizeof(ClipboardHistorySnapshot) + clip_history_snapshot_rows_size(capacity));
+    snapshot->refs = 1;
+    snapshot->length = 0;
+    clip_history_snapshot_layout(snapshot, (char*)(snapshot + 1), capacity);
+    snapshot->offsets[0] = 0;
+    memset(snapshot->tag_rows, 0xff, sizeof(snapshot->tag_rows));
+    // Every row's text is NUL-terminated.
+    snapshot->arena_size = text_size + capacity;
+    snapshot->arena = g_malloc(MAX(1, snapshot->arena_size));
+    return snapshot;
+}
+
+ClipboardHistorySnapshot* clip_history_snapshot_ref(ClipboardHistorySnapshot *snapshot)
+{
+    if(snapshot == NULL){
+        return NULL;
+    }
+    g_atomic_int_inc(&snapshot->refs);
+    return snapshot;
+}
+
+void clip_history_snapshot_unref(ClipboardHistorySnapshot *snapshot)
+{
+    if(snapshot == NULL || !g_atomic_int_dec_and_test(&snapshot->refs)){
+        return;
+    }
+    if(!clip_history_snapshot_has_inline_rows(snapshot)){
+        g_free(snapshot->ids);
+    }
+    g_free(snapshot->arena);
+    snapshot->arena = NULL;
+    g_free(snapshot);
+}
+
+/**
+ * Moves the rows into a new allocation. This only happens if the history changed between sizing and filling the
+ * snapshot.
+ */
+static void clip_history_snapshot_grow_rows(ClipboardHistorySnapshot *snapshot)
+{
+    guint capacity = MAX(16, snapshot->capacity * 2);
+    char *rows = g_malloc(clip_history_snapshot_rows_size(capacity));
+    int64_t *ids = snapshot->ids;
+    gsize *offsets = snapshot->offsets;
+    guint8 *flags = snapshot->flags;
+    char *tags = snapshot->tags;
+    gboolean inline_rows = clip_history_snapshot_has_inline_rows(snapshot);
+
+    clip_history_snapshot_layout(snapshot, rows, capacity);
+    memcpy(snapshot->ids, ids, snapshot->length * sizeof(int64_t));
+    memcpy(snapshot->offsets, offsets, (snapshot->length + 1) * sizeof(gsize));
+    memcpy(snapshot->flags, flags, snapshot->length * sizeof(guint8));
+    memcpy(snapshot->tags, tags, snapshot->length * sizeof(char));
+    if(!inline_rows){
+        g_free(ids);
+    }
+}
+
+void clip_history_snapshot_append(ClipboardHistorySnapshot *snapshot, int64_t id, const char *text, gsize length,
+        gboolean locked, gboolean masked, char tag)
+{
+    if(snapshot->length == snapshot->capacity){
+        warn("History snapshot under-sized at %u rows. Growing.\n", snapshot->capacity);
+        clip_history_snapshot_grow_rows(snapshot);
+    }
+
+    guint row = snapshot->length;
+    gsize offset = snapshot->offsets[row];
+    if(offset + length + 1 > snapshot->arena_size){
+        snapshot->arena_size = MAX(snapshot->arena_size * 2, offset + length + 1);
+        snapshot->arena = g_realloc(snapshot->arena, snapshot->arena_size);
+    }
+
+    memcpy(snapshot->arena + offset, text, length);
+    snapshot->arena[offset + length] = '\0';
+
+    snapshot->ids[row] = id;
+    snapshot->flags[row] = (locked ? SNAPSHOT_LOCKED : 0) | (masked ? SNAPSHOT_MASKED : 0);
+    snapshot->tags[row] = tag;
+    if(tag != 0 && snapshot->tag_rows[(guchar)tag] < 0){
+        snapshot->tag_rows[(guchar)tag] = row;
+    }
+    snapshot->offsets[row + 1] = offset + length + 1;
+    snapshot->length++;
+}
+
+
+guint clip_history_snapshot_get_length(ClipboardHistorySnapshot *snapshot)
+{
+    if(snapshot == NULL){
+        return 0;
+    }
+    return snapshot->length;
+}
+
+gint clip_history_snapshot_find(ClipboardHistorySnapshot *snapshot, int64_t id)
+{
+    for(guint row = 0; row < clip_history_snapshot_get_length(snapshot); row++){
+        if(snapshot->ids[row] == id){
+            return row;
+        }
+    }
+    return -1;
+}
+
+gint clip_history_snapshot_find_tag(ClipboardHistorySnapshot *snapshot, char tag)
+{
+    if(snapshot == NULL || tag == 0){
+        return -1;
+    }
+    return snapshot->tag_rows[(guchar)tag];
+}
+
+int64_t clip_history_snapshot_get_id(ClipboardHistorySnapshot *snapshot, guint row)
+{
+    return snapshot->ids[row];
+}
+
+const char* clip_history_snapshot_get_text(ClipboardHistorySnapshot *snapshot, guint row)
+{
+    return snapshot->arena + snapshot->offsets[row];
+}
+
+gsize clip_history_snapshot_get_text_length(ClipboardHistorySnapshot *snapshot, guint row)
+{
+    return snapshot->offsets[row + 1] - snapshot->offsets[row] - 1;
+}
+
+gboolean clip_history_snapshot_is_locked(ClipboardHistorySnapshot *snapshot, guint row)
+{
+    return (snapshot->flags[row] & SNAPSHOT_LOCKED) != 0;
+}
+
+gboolean clip_history_snapshot_is_masked(ClipboardHistorySnapshot *snapshot, guint row)
+{
+    return (snapshot->flags[row] & SNAPSHOT_MASKED) != 0;
+}
+
+char clip_history_snapshot_get_tag(ClipboardHistorySnapshot *snapshot, guint row)
+{
+    return snapshot->tags[row];
+}
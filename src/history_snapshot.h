@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+#include <inttypes.h>
+
+typedef struct history_snapshot ClipboardHistorySnapshot;
+
+/**
+ * Creates an empty snapshot sized for the specified number of rows and bytes of text. Row data is packed into
+ * contiguous arrays and all text is copied into a single arena, so a snapshot costs two allocations regardless of how
+ * many rows it holds. If the estimate is exceeded, the snapshot grows.
+ */
+ClipboardHistorySnapshot* clip_history_snapshot_new(guint capacity, gsize text_size);
+ClipboardHistorySnapshot* clip_history_snapshot_ref(ClipboardHistorySnapshot *snapshot);
+void clip_history_snapshot_unref(ClipboardHistorySnapshot *snapshot);
+
+/**
+ * Appends a row to the end of the snapshot, copying the text into the arena.
+ */
+void clip_history_snapshot_append(ClipboardHistorySnapshot *snapshot, int64_t id, const char *text, gsize length,
+        gboolean locked, gboolean masked, char tag);
+
+/**
+ * Returns the number of rows in the snapshot. Rows are ordered newest first.
+ */
+guint clip_history_snapshot_get_length(ClipboardHistorySnapshot *snapshot);
+/**
+ * Returns the row holding the specified id, or -1 if there isn't one.
+ */
+gint clip_history_snapshot_find(ClipboardHistorySnapshot *snapshot, int64_t id);
+/**
+ * Returns the row holding the specified tag, or -1 if there isn't one.
+ */
+gint clip_history_snapshot_find_tag(ClipboardHistorySnapshot *snapshot, char tag);
+
+int64_t clip_history_snapshot_get_id(ClipboardHistorySnapshot *snapshot, guint row);
+/**
+ * Return a pointer to the row's NUL-terminated text within the arena. This value must not be modified.
+ */
+const char* clip_history_snapshot_get_text(ClipboardHistorySnapshot *snapshot, guint row);
+gsize clip_history_snapshot_get_text_length(ClipboardHistorySnapshot *snapshot, guint row);
+gboolean clip_history_snapshot_is_locked(ClipboardHistorySnapshot *snapshot, guint row);
+gboolean clip_history_snapshot_is_masked(ClipboardHistorySnapshot *snapshot, guint row);
+char clip_history_snapshot_get_tag(ClipboardHistorySnapshot *snapshot, guint row);
@@ -70,10 +70,22 @@ struct Binding {
 };
 
 static GSList *bindings = NULL;
+/* Bindings by (keyval, modifiers), see binding_key */
+static GHashTable *binding_index = NULL;
 static guint32 last_event_time = 0;
 static gboolean processing_event = FALSE;
 static gboolean detected_xkb_extension = FALSE;
 static gboolean use_xkb_extension = FALSE;
+/* The XKB client map, fetched once per keymap */
+static XkbDescPtr xkb_map = NULL;
+/* Set while grabs are issued in one pass, see keymap_changed */
+static gboolean batching_grabs = FALSE;
+
+/* Key presses captured from the root window, see keybinder_capture_keys */
+static KeybinderKeyHandler capture_handler = NULL;
+static void *capture_user_data = NULL;
+static guint32 capture_time = 0;
+static gboolean capture_grabbed = FALSE;
 
 /* Return the modifier mask that needs to be pressed to produce key in the
  * given group (keyboard layout) and level ("shift level").
@@ -147,7 +159,8 @@ grab_ungrab_with_ignorable_modifiers (GdkWindow *rootwin,
 		GDK_MOD2_MASK | GDK_LOCK_MASK,
 	};
 
-	gdk_error_trap_push ();
+	if (!batching_grabs)
+		gdk_error_trap_push ();
 
 	for (i = 0; i < G_N_ELEMENTS (mod_masks); i++) {
 		if (grab) {
@@ -165,6 +178,10 @@ grab_ungrab_with_ignorable_modifiers (GdkWindow *rootwin,
 			            GDK_WINDOW_XID (rootwin));
 		}
 	}
+	/* Errors are checked once for the whole batch */
+	if (batching_grabs)
+		return TRUE;
+
 	gdk_flush();
 	if (gdk_error_trap_pop()) {
 		TRACE (g_print ("Failed grab/ungrab!\n"));
@@ -181,6 +198,29 @@ grab_ungrab_with_ignorable_modifiers (GdkWindow *rootwin,
 	return success;
 }
 
+/* Return the XKB client map, fetching it if the keymap changed since it was
+ * last fetched.
+ */
+static XkbDescPtr
+get_xkb_map (Display *display)
+{
+	if (xkb_map == NULL) {
+		xkb_map = XkbGetMap(display,
+		                    XkbAllClientInfoMask,
+		                    XkbUseCoreKbd);
+	}
+	return xkb_map;
+}
+
+static void
+free_xkb_map (void)
+{
+	if (xkb_map) {
+		XkbFreeClientMap(xkb_map, 0, TRUE);
+		xkb_map = NULL;
+	}
+}
+
 /* Grab or ungrab then keyval and modifiers combination, grabbing all key
  * combinations yielding the same key values.
  * Includes ignorable modifiers using grab_ungrab_with_ignorable_modifiers.
@@ -200,9 +240,7 @@ grab_ungrab (GdkWindow *rootwin,
 	gboolean success = FALSE;
 
 	if (use_xkb_extension) {
-		xmap = XkbGetMap(GDK_WINDOW_XDISPLAY(rootwin),
-		                 XkbAllClientInfoMask,
-		                 XkbUseCoreKbd);
+		xmap = get_xkb_map(GDK_WINDOW_XDISPLAY(rootwin));
 	}
 
 	map = gdk_keymap_get_default();
@@ -255,39 +293,48 @@ grab_ungrab (GdkWindow *rootwin,
 
 	}
 	g_free(keys);
-	if (xmap) {
-		XkbFreeClientMap(xmap, 0, TRUE);
-	}
 
 	return success;
 }
 
-static gboolean
-keyvalues_equal (guint kv1, guint kv2)
-{
-	return kv1 == kv2;
-}
-
-/* Compare modifier set equality,
- * while accepting overloaded modifiers (MOD1 and META together)
+/* Pack a keyval and modifier set into a single lookup key, while
+ * accepting overloaded modifiers (MOD1 and META together)
  */
-static gboolean
-modifiers_equal (GdkModifierType mf1, GdkModifierType mf2)
+static gint64
+binding_key (guint keyval, GdkModifierType modifiers)
 {
-	GdkModifierType ignored = 0;
-
 	/* Accept MOD1 + META as MOD1 */
-	if (mf1 & mf2 & GDK_MOD1_MASK) {
-		ignored |= GDK_META_MASK;
+	if (modifiers & GDK_MOD1_MASK) {
+		modifiers &= ~GDK_META_MASK;
 	}
 	/* Accept SUPER + HYPER as SUPER */
-	if (mf1 & mf2 & GDK_SUPER_MASK) {
-		ignored |= GDK_HYPER_MASK;
+	if (modifiers & GDK_SUPER_MASK) {
+		modifiers &= ~GDK_HYPER_MASK;
 	}
-	if ((mf1 & ~ignored) == (mf2 & ~ignored)) {
-		return TRUE;
+	return ((gint64) keyval << 32) | (guint32) modifiers;
+}
+
+/* Add or remove the binding from the list of bindings for its key */
+static void
+index_binding (struct Binding *binding, gboolean add)
+{
+	gint64 *key = g_new (gint64, 1);
+	GSList *list;
+
+	*key = binding_key (binding->keyval, binding->modifiers);
+	list = g_hash_table_lookup (binding_index, key);
+	if (add) {
+		list = g_slist_prepend (list, binding);
+	} else {
+		list = g_slist_remove (list, binding);
+	}
+
+	if (list == NULL) {
+		g_hash_table_remove (binding_index, key);
+		g_free (key);
+	} else {
+		g_hash_table_insert (binding_index, key, list);
 	}
-	return FALSE;
 }
 
 static gboolean
@@ -353,6 +400,34 @@ do_ungrab_key (struct Binding *binding)
 	return TRUE;
 }
 
+/* Translate a captured key press into the event GTK would have produced
+ * had it been delivered to one of our windows.
+ */
+static GdkEvent *
+key_event_new (XKeyEvent *xkey)
+{
+	GdkKeymap *keymap = gdk_keymap_get_default ();
+	GdkDisplay *display = gdk_display_get_default ();
+	GdkEvent *event = gdk_event_new (GDK_KEY_PRESS);
+	guint keyval = GDK_KEY_VoidSymbol;
+	gint group = gdk_x11_keymap_get_group_for_state (keymap, xkey->state);
+
+	gdk_keymap_translate_keyboard_state (keymap, xkey->keycode,
+	                                     xkey->state, group,
+	                                     &keyval, NULL, NULL, NULL);
+	event->key.send_event = TRUE;
+	event->key.time = xkey->time;
+	event->key.state = xkey->state;
+	event->key.keyval = keyval;
+	event->key.hardware_keycode = xkey->keycode;
+	event->key.group = group;
+	event->key.is_modifier =
+		gdk_x11_keymap_key_is_modifier (keymap, xkey->keycode);
+	gdk_event_set_device (event,
+		gdk_seat_get_keyboard (gdk_display_get_default_seat (display)));
+	return event;
+}
+
 static GdkFilterReturn
 filter_func (GdkXEvent *gdk_xevent, GdkEvent *event, gpointer data)
 {
@@ -405,7 +480,9 @@ filter_func (GdkXEvent *gdk_xevent, GdkEvent *event, gpointer data)
 		processing_event = TRUE;
 		last_event_time = xevent->xkey.time;
 
-		iter = bindings;
+		gint64 key = binding_key (keyval, modifiers);
+		gboolean handled = FALSE;
+		iter = g_hash_table_lookup (binding_index, &key);
 		while (iter != NULL) {
 			/* NOTE: ``iter`` might be removed from the list
 			 * in the callback.
@@ -413,17 +490,22 @@ filter_func (GdkXEvent *gdk_xevent, GdkEvent *event, gpointer data)
 			struct Binding *binding = iter->data;
 			iter = iter->next;
 
-			if (keyvalues_equal(binding->keyval, keyval) &&
-			    modifiers_equal(binding->modifiers, modifiers)) {
-				TRACE (g_print ("Calling handler for '%s'...\n", 
-						binding->keystring));
+			TRACE (g_print ("Calling handler for '%s'...\n", 
+					binding->keystring));
 
-				(binding->handler) (binding->keystring, 
-						    binding->user_data);
-			}
+			(binding->handler) (binding->keystring, 
+					    binding->user_data);
+			handled = TRUE;
 		}
 
 		processing_event = FALSE;
+
+		if (!handled && capture_handler != NULL) {
+			TRACE (g_print ("Capturing keyval: %d\n", keyval));
+			capture_handler (key_event_new (&xevent->xkey),
+			                 capture_user_data);
+			return GDK_FILTER_REMOVE;
+		}
 		break;
 	case KeyRelease:
 		TRACE (g_print ("Got KeyRelease! \n"));
@@ -436,21 +518,40 @@ filter_func (GdkXEvent *gdk_xevent, GdkEvent *event, gpointer data)
 static void
 keymap_changed (GdkKeymap *map)
 {
+	GdkWindow *rootwin = gdk_get_default_root_window ();
 	GSList *iter;
 
 	(void) map;
 
 	TRACE (g_print ("Keymap changed! Regrabbing keys..."));
 
-	for (iter = bindings; iter != NULL; iter = iter->next) {
-		struct Binding *binding = iter->data;
-		do_ungrab_key (binding);
-	}
+	free_xkb_map ();
 
+	/* Every grab on the root window is one of ours. Releasing them all at
+	 * once also releases keycodes the new keymap no longer maps.
+	 */
+	gdk_error_trap_push ();
+	batching_grabs = TRUE;
+	XUngrabKey (GDK_WINDOW_XDISPLAY (rootwin),
+	            AnyKey,
+	            AnyModifier,
+	            GDK_WINDOW_XID (rootwin));
 	for (iter = bindings; iter != NULL; iter = iter->next) {
 		struct Binding *binding = iter->data;
 		do_grab_key (binding);
 	}
+	batching_grabs = FALSE;
+	gdk_flush ();
+
+	if (gdk_error_trap_pop ()) {
+		/* Regrab one at a time to find, and release, what failed */
+		TRACE (g_print ("Batched regrab failed! Retrying..."));
+		for (iter = bindings; iter != NULL; iter = iter->next) {
+			struct Binding *binding = iter->data;
+			do_ungrab_key (binding);
+			do_grab_key (binding);
+		}
+	}
 }
 
 /**
@@ -466,18 +567,13 @@ keybinder_init ()
 {
 	GdkKeymap *keymap = gdk_keymap_get_default ();
 	GdkWindow *rootwin = gdk_get_default_root_window ();
-	Display *disp;
+	Display *disp = GDK_WINDOW_XDISPLAY (rootwin);
 	int xkb_opcode;
 	int xkb_event_base;
 	int xkb_error_base;
 	int majver = XkbMajorVersion;
 	int minver = XkbMinorVersion;
 
-	if (!(disp = XOpenDisplay(NULL))) {
-		g_warning("keybinder_init: Unable to open display");
-		return;
-	}
-
 	detected_xkb_extension = XkbQueryExtension(disp,
 	                                           &xkb_opcode,
 	                                           &xkb_event_base,
@@ -487,6 +583,8 @@ keybinder_init ()
 	use_xkb_extension = detected_xkb_extension;
 	TRACE(g_print("XKB: %d, version: %d, %d\n", use_xkb_extension, majver, minver));
 
+	binding_index = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+	                                       g_free, NULL);
 	gdk_window_add_filter (rootwin, filter_func, NULL);
 
 	/* Workaround: Make sure modmap is up to date
@@ -587,6 +685,7 @@ keybinder_bind_full (const char *keystring,
 
 	if (success) {
 		bindings = g_slist_prepend (bindings, binding);
+		index_binding (binding, TRUE);
 	} else {
 		g_free (binding->keystring);
 		g_free (binding);
@@ -621,6 +720,7 @@ keybinder_unbind (const char *keystring, KeybinderHandler handler)
 
 		do_ungrab_key (binding);
 		bindings = g_slist_remove (bindings, binding);
+		index_binding (binding, FALSE);
 
 		TRACE (g_print("unbind, notify: %p\n", binding->notify));
 		if (binding->notify) {
@@ -654,6 +754,7 @@ void keybinder_unbind_all (const char *keystring)
 
 		do_ungrab_key (binding);
 		bindings = g_slist_remove (bindings, binding);
+		index_binding (binding, FALSE);
 
 		TRACE (g_print("unbind_all, notify: %p\n", binding->notify));
 		if (binding->notify) {
@@ -669,6 +770,70 @@ void keybinder_unbind_all (const char *keystring)
 	}
 }
 
+/**
+ * keybinder_capture_keys:
+ * @handler:   (allow-none): callback receiving captured key presses
+ * @user_data: data to pass to @handler
+ *
+ * Grab the keyboard as of the bound key press being handled, so that keys
+ * typed before a window of ours takes the keyboard aren't delivered to
+ * other clients. Key presses the grab routes to the root window are
+ * translated and passed to @handler, which owns the event.
+ *
+ * Must be called from a #KeybinderHandler. The grab lasts until
+ * keybinder_release_keyboard(); key presses already on their way to the
+ * root window are still captured until this is called with a %NULL
+ * @handler.
+ */
+void
+keybinder_capture_keys (KeybinderKeyHandler handler, void *user_data)
+{
+	GdkWindow *rootwin = gdk_get_default_root_window ();
+
+	if (handler == NULL) {
+		keybinder_release_keyboard ();
+		capture_handler = NULL;
+		capture_user_data = NULL;
+		return;
+	}
+
+	capture_handler = handler;
+	capture_user_data = user_data;
+	if (capture_grabbed || !processing_event)
+		return;
+
+	/* The passive grab of the bound key is already active, so this
+	 * only extends it past the key's release.
+	 */
+	capture_time = last_event_time;
+	capture_grabbed = XGrabKeyboard (GDK_WINDOW_XDISPLAY (rootwin),
+	                                 GDK_WINDOW_XID (rootwin),
+	                                 False,
+	                                 GrabModeAsync,
+	                                 GrabModeAsync,
+	                                 capture_time) == GrabSuccess;
+	TRACE (g_print ("Keyboard grab for capture: %d\n", capture_grabbed));
+}
+
+/**
+ * keybinder_release_keyboard:
+ *
+ * Release the grab taken by keybinder_capture_keys(). The grab is released
+ * as of the time it was taken, so a grab one of our windows has taken
+ * since is left in place.
+ */
+void
+keybinder_release_keyboard (void)
+{
+	GdkWindow *rootwin = gdk_get_default_root_window ();
+
+	if (!capture_grabbed)
+		return;
+	XUngrabKeyboard (GDK_WINDOW_XDISPLAY (rootwin), capture_time);
+	gdk_flush ();
+	capture_grabbed = FALSE;
+}
+
 /**
  * keybinder_get_current_event_time:
  *
@@ -25,11 +25,14 @@
 #define __KEY_BINDER_H__
 
 #include <glib.h>
+#include <gdk/gdk.h>
 
 G_BEGIN_DECLS
 
 typedef void (* KeybinderHandler) (const char *keystring, void *user_data);
 
+typedef void (* KeybinderKeyHandler) (GdkEvent *event, void *user_data);
+
 void keybinder_init (void);
 
 void keybinder_set_use_cooked_accelerators (gboolean use_cooked);
@@ -49,6 +52,10 @@ void keybinder_unbind (const char *keystring,
 
 void keybinder_unbind_all (const char *keystring);
 
+void keybinder_capture_keys (KeybinderKeyHandler handler, void *user_data);
+
+void keybinder_release_keyboard (void);
+
 guint32 keybinder_get_current_event_time (void);
 
 G_END_DECLS
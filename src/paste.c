@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "paste.h"
+#include "histogram.h"
+#include "utils.h"
+
+#include <gtk/gtk.h>
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/XTest.h>
+
+static gboolean available = FALSE;
+// The window to paste into, or None.
+static Window focus = None;
+// Time from a paste being asked for to the server accepting its synthetic keystroke.
+static ClipHistogram *paste_latency = NULL;
+
+
+
+void clip_paste_init(void)
+{
+    int event_base, error_base, major, minor;
+    Display *display = GDK_DISPLAY_XDISPLAY(gdk_display_get_default());
+    available = XTestQueryExtension(display, &event_base, &error_base, &major, &minor);
+    if(!available){
+        warn("XTest is not available. Pasting is disabled.\n");
+    }
+    paste_latency = clip_histogram_new("Activate to keystroke sent");
+}
+
+void clip_paste_destroy(void)
+{
+    clip_histogram_log(paste_latency);
+    clip_histogram_free(paste_latency);
+    paste_latency = NULL;
+    focus = None;
+}
+
+void clip_paste_remember_focus(void)
+{
+    int revert;
+    Display *display = GDK_DISPLAY_XDISPLAY(gdk_display_get_default());
+    XGetInputFocus(display, &focus, &revert);
+    if(focus == PointerRoot){
+        focus = None;
+    }
+}
+
+/**
+ * Presses, or releases, each modifier key in the mask.
+ */
+static void clip_paste_send_modifiers(Display *display, GdkModifierType modifiers, gboolean press)
+{
+    static const struct {
+        GdkModifierType mask;
+        guint key;
+    } keys[] = {
+        {GDK_CONTROL_MASK, GDK_KEY_Control_L},
+        {GDK_SHIFT_MASK, GDK_KEY_Shift_L},
+        {GDK_MOD1_MASK, GDK_KEY_Alt_L},
+        {GDK_SUPER_MASK, GDK_KEY_Super_L},
+    };
+    for(guint i = 0; i < G_N_ELEMENTS(keys); i++){
+        KeyCode code = XKeysymToKeycode(display, keys[i].key);
+        if((modifiers & keys[i].mask) && code != 0){
+            XTestFakeKeyEvent(display, code, press, CurrentTime);
+        }
+    }
+}
+
+/**
+ * Returns the keycodes of the modifier keys that are down.
+ */
+static GArray* clip_paste_get_held_modifiers(Display *display)
+{
+    char keys[32];
+    XQueryKeymap(display, keys);
+    XModifierKeymap *map = XGetModifierMapping(display);
+    GArray *held = g_array_new(FALSE, FALSE, sizeof(KeyCode));
+    for(int i = 0; i < 8 * map->max_keypermod; i++){
+        KeyCode code = map->modifiermap[i];
+        if(code != 0 && (keys[code / 8] & (1 << (code % 8)))){
+            g_array_append_val(held, code);
+        }
+    }
+    XFreeModifiermap(map);
+    return held;
+}
+
+static void clip_paste_send_keys(Display *display, GArray *codes, gboolean press)
+{
+    for(guint i = 0; i < codes->len; i++){
+        XTestFakeKeyEvent(display, g_array_index(codes, KeyCode, i), press, CurrentTime);
+    }
+}
+
+gboolean clip_paste_send(gint64 start_time)
+{
+    if(!available){
+        return FALSE;
+    }
+
+    guint keyval = 0;
+    GdkModifierType modifiers = 0;
+    gtk_accelerator_parse(GUI_PASTE_KEY, &keyval, &modifiers);
+    GdkDisplay *gdk_display = gdk_display_get_default();
+    Display *display = GDK_DISPLAY_XDISPLAY(gdk_display);
+    KeyCode code = XKeysymToKeycode(display, keyval);
+    if(code == 0){
+        warn("Paste key, %s, isn't on the keyboard.\n", GUI_PASTE_KEY);
+        return FALSE;
+    }
+
+    // A bound key grabs the keyboard for as long as it's held, which would route the keystroke back to us. Nothing
+    // else of ours holds the keyboard once the pop-up is hidden.
+    XUngrabKeyboard(display, CurrentTime);
+    // The window may have gone away while the pop-up was shown.
+    gdk_x11_display_error_trap_push(gdk_display);
+    if(focus != None){
+        XSetInputFocus(display, focus, RevertToParent, CurrentTime);
+    }
+    GArray *held = clip_paste_get_held_modifiers(display);
+    clip_paste_send_keys(display, held, FALSE);
+    clip_paste_send_modifiers(display, modifiers, TRUE);
+    XTestFakeKeyEvent(display, code, True, CurrentTime);
+    XTestFakeKeyEvent(display, code, False, CurrentTime);
+    clip_paste_send_modifiers(display, modifiers, FALSE);
+    clip_paste_send_keys(display, held, TRUE);
+    g_array_free(held, TRUE);
+    // Wait for the server to process the fake events. This is as far as the latency goes: the target window reading the
+    // keystroke and pasting happens in another client, out of sight.
+    XSync(display, False);
+    if(gdk_x11_display_error_trap_pop(gdk_display)){
+        debug("Focus couldn't be returned before pasting.\n");
+    }
+
+    clip_histogram_record(paste_latency, g_get_monotonic_time() - start_time);
+    trace("Pasted into window 0x%lx.\n", focus);
+    focus = None;
+    return TRUE;
+}
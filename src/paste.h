@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+
+/**
+ * Checks for the XTest extension, which pasting requires.
+ */
+void clip_paste_init(void);
+void clip_paste_destroy(void);
+
+/**
+ * Remembers the window with the input focus. This must be done before the pop-up is shown, so that the remembered
+ * window is the one the user was typing into.
+ */
+void clip_paste_remember_focus(void);
+
+/**
+ * Returns focus to the remembered window and types GUI_PASTE_KEY into it through XTest. Modifiers the user is still
+ * holding, such as those of a direct key, are released around the keystroke so they don't change it. start_time is
+ * when the paste was asked for, as returned by g_get_monotonic_time(). The time until the X server has processed the
+ * keystroke is recorded; when the target window actually pastes isn't known.
+ * Returns FALSE if the keystroke couldn't be sent.
+ */
+gboolean clip_paste_send(gint64 start_time);
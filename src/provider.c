@@ -23,16 +23,47 @@
 #include "utils.h"
 
 #include <gtk/gtk.h>
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
 #include <string.h>
 
+// Resolved owners are forgotten once there are this many.
+#define SOURCE_CACHE_LIMIT 64
+
+typedef struct {
+    const char *class;
+    ClipSourcePolicy policy;
+} SourceRule;
+
+static const SourceRule source_rules[] = { SOURCE_RULES { NULL, SOURCE_KEEP } };
+
 struct provider {
     GtkClipboard *clipboard;
 #if SYNC_ANY
     GtkClipboard *selection;
 #endif
-    char *current;
+    ClipboardText *current;
     gboolean ownership_transferred;
     gboolean locked;
+
+    // The policies of the clipboards' owners, resolved when ownership changes, and of the current value's owner.
+    ClipSourcePolicy clipboard_source;
+#if SYNC_CLIPBOARDS
+    ClipSourcePolicy selection_source;
+#endif
+    ClipSourcePolicy current_source;
+    // The clipboards' owners when their policies were resolved.
+    Window clipboard_owner;
+#if SYNC_CLIPBOARDS
+    Window selection_owner;
+#endif
+    // Policies by owner window.
+    GHashTable *sources;
+    // A value from a settling owner, and when it was first seen.
+    char *settling;
+    gint64 settling_time;
 };
 
 
@@ -42,12 +73,157 @@ static void clip_provider_unlock(ClipboardProvider *provider)
 }
 
 
+static ClipSourcePolicy clip_provider_match_class(Display *display, Window window, gboolean *matched)
+{
+    XClassHint hint = {NULL, NULL};
+    if(!XGetClassHint(display, window, &hint)){
+        *matched = FALSE;
+        return SOURCE_KEEP;
+    }
+
+    ClipSourcePolicy policy = SOURCE_KEEP;
+    for(const SourceRule *rule = source_rules; rule->class != NULL; rule++){
+        if(!g_strcmp0(rule->class, hint.res_class) || !g_strcmp0(rule->class, hint.res_name)){
+            policy = rule->policy;
+            break;
+        }
+    }
+    trace("Clipboard owner is %s.%s.\n", hint.res_name, hint.res_class);
+    XFree(hint.res_name);
+    XFree(hint.res_class);
+    *matched = TRUE;
+    return policy;
+}
+
+static Window clip_provider_get_client_leader(Display *display, Window window)
+{
+    Atom type = None;
+    int format = 0;
+    unsigned long count = 0, remaining = 0;
+    unsigned char *data = NULL;
+    Window leader = None;
+    if(XGetWindowProperty(display, window, XInternAtom(display, "WM_CLIENT_LEADER", False), 0, 1, False, XA_WINDOW,
+                &type, &format, &count, &remaining, &data) == Success && type == XA_WINDOW && count == 1){
+        leader = *(Window*)data;
+    }
+    if(data != NULL){
+        XFree(data);
+    }
+    return leader;
+}
+
+/**
+ * Finds the WM_CLASS of the application owning the window. Selections are usually owned by an unmapped or child window,
+ * so this falls back to the window's client leader, then to its ancestors.
+ */
+static ClipSourcePolicy clip_provider_match_owner(Display *display, Window owner)
+{
+    gboolean matched = FALSE;
+    ClipSourcePolicy policy = clip_provider_match_class(display, owner, &matched);
+    Window leader = matched ? None : clip_provider_get_client_leader(display, owner);
+    if(leader != None && leader != owner){
+        policy = clip_provider_match_class(display, leader, &matched);
+    }
+
+    Window window = owner;
+    while(!matched){
+        Window root = None, parent = None, *children = NULL;
+        unsigned int count = 0;
+        if(!XQueryTree(display, window, &root, &parent, &children, &count)){
+            break;
+        }
+        if(children != NULL){
+            XFree(children);
+        }
+        if(parent == None || parent == root){
+            break;
+        }
+        window = parent;
+        policy = clip_provider_match_class(display, window, &matched);
+    }
+    return policy;
+}
+
+/**
+ * Returns the policy of the selection's owner. Owners are looked up once and then cached until they're destroyed, so
+ * owners that take the selection over and over, as terminals do, cost one round trip each time.
+ */
+static ClipSourcePolicy clip_provider_resolve_source(ClipboardProvider *provider, GdkAtom selection, Window *owner_out)
+{
+    *owner_out = None;
+    if(source_rules[0].class == NULL){
+        return SOURCE_KEEP;
+    }
+
+    GdkDisplay *display = gdk_display_get_default();
+    Display *xdisplay = GDK_DISPLAY_XDISPLAY(display);
+    Window owner = XGetSelectionOwner(xdisplay, gdk_x11_atom_to_xatom(selection));
+    *owner_out = owner;
+    if(owner == None){
+        return SOURCE_KEEP;
+    }
+
+    gpointer cached = NULL;
+    if(g_hash_table_lookup_extended(provider->sources, GSIZE_TO_POINTER(owner), NULL, &cached)){
+        return GPOINTER_TO_INT(cached);
+    }
+
+    // The owner may be destroyed at any time. Its destruction is watched for before it's looked up, so the policy can
+    // be dropped before the XID is reused; if it's already gone, the policy isn't cached at all.
+    gdk_x11_display_error_trap_push(display);
+    XWindowAttributes attributes;
+    if(XGetWindowAttributes(xdisplay, owner, &attributes)){
+        XSelectInput(xdisplay, owner, attributes.your_event_mask | StructureNotifyMask);
+    }
+    ClipSourcePolicy policy = clip_provider_match_owner(xdisplay, owner);
+    if(gdk_x11_display_error_trap_pop(display)){
+        debug("Clipboard owner, 0x%lx, was destroyed while its policy was resolved.\n", owner);
+        return policy;
+    }
+
+    if(g_hash_table_size(provider->sources) >= SOURCE_CACHE_LIMIT){
+        g_hash_table_remove_all(provider->sources);
+    }
+    g_hash_table_insert(provider->sources, GSIZE_TO_POINTER(owner), GINT_TO_POINTER(policy));
+    debug("Clipboard owner, 0x%lx, has capture policy %d.\n", owner, policy);
+    return policy;
+}
+
+/**
+ * Forgets the policies of destroyed owners, since their XIDs may be handed to other clients.
+ */
+static GdkFilterReturn clip_provider_filter_destroyed(GdkXEvent *xevent, GdkEvent *event, gpointer data)
+{
+    ClipboardProvider *provider = data;
+    XEvent *x = xevent;
+    if(x->type == DestroyNotify && g_hash_table_remove(provider->sources, GSIZE_TO_POINTER(x->xdestroywindow.window))){
+        trace("Clipboard owner, 0x%lx, was destroyed.\n", x->xdestroywindow.window);
+    }
+    return GDK_FILTER_CONTINUE;
+}
+
 void clip_provider_cb_owner_changed(GtkClipboard *clipboard, GdkEvent *event, gpointer data)
 {
-    if(((GdkEventOwnerChange*)event)->reason != GDK_OWNER_CHANGE_NEW_OWNER) {
+    ClipboardProvider *provider = data;
+    GdkEventOwnerChange *owner_change = (GdkEventOwnerChange*)event;
+    if(owner_change->reason != GDK_OWNER_CHANGE_NEW_OWNER) {
         debug("Clipboard owner has been destroyed. Going to ignore next value if null.\n");
-        ((ClipboardProvider*)data)->ownership_transferred = TRUE;
+        provider->ownership_transferred = TRUE;
+    }
+
+    Window *owner = &provider->clipboard_owner;
+    ClipSourcePolicy *policy = &provider->clipboard_source;
+#if SYNC_CLIPBOARDS
+    if(owner_change->selection == GDK_SELECTION_PRIMARY){
+        owner = &provider->selection_owner;
+        policy = &provider->selection_source;
     }
+#endif
+    // The owner's window is gone and its XID may be handed to another client, so its cached policy can't be kept.
+    if(owner_change->reason != GDK_OWNER_CHANGE_NEW_OWNER && *owner != None){
+        g_hash_table_remove(provider->sources, GSIZE_TO_POINTER(*owner));
+    }
+    *policy = clip_provider_resolve_source(provider, owner_change->selection, owner);
 }
 
 ClipboardProvider* clip_provider_new(void)
@@ -60,6 +236,17 @@ ClipboardProvider* clip_provider_new(void)
     provider->current = NULL;
     provider->ownership_transferred = FALSE;
     provider->locked = FALSE;
+    provider->sources = g_hash_table_new(g_direct_hash, g_direct_equal);
+    provider->settling = NULL;
+    provider->settling_time = 0;
+    gdk_window_add_filter(NULL, clip_provider_filter_destroyed, provider);
+    provider->clipboard_source = clip_provider_resolve_source(provider, GDK_SELECTION_CLIPBOARD,
+        &provider->clipboard_owner);
+#if SYNC_CLIPBOARDS
+    provider->selection_source = clip_provider_resolve_source(provider, GDK_SELECTION_PRIMARY,
+        &provider->selection_owner);
+#endif
+    provider->current_source = SOURCE_KEEP;
 
     g_signal_connect(G_OBJECT(provider->clipboard), "owner-change", G_CALLBACK(clip_provider_cb_owner_changed), provider);
 #if SYNC_CLIPBOARDS
@@ -85,8 +272,13 @@ void clip_provider_free(ClipboardProvider *provider)
     provider->selection = NULL;
 #endif
 
-    g_free(provider->current);
+    gdk_window_remove_filter(NULL, clip_provider_filter_destroyed, provider);
+    clip_clipboard_text_unref(provider->current);
     provider->current = NULL;
+    g_hash_table_destroy(provider->sources);
+    provider->sources = NULL;
+    g_free(provider->settling);
+    provider->settling = NULL;
 
     g_free(provider);
 }
@@ -133,38 +325,42 @@ gboolean clip_provider_is_provider_ready()
  * the same string), the current selection is unhilighted. As such, only swap the two values if they are actually
  * different, textually.
  */
-static gboolean clip_provider_set_if_different(GtkClipboard *clipboard, char *new)
+static gboolean clip_provider_set_if_different(GtkClipboard *clipboard, ClipboardText *new)
 {
     gboolean changed = FALSE;
     char *old = gtk_clipboard_wait_for_text(clipboard);
-    if(g_strcmp0(old, new)){
-        gtk_clipboard_set_text(clipboard, new == NULL ? "" : new, -1);
+    if(g_strcmp0(old, clip_clipboard_text_get_str(new))){
+        if(new == NULL){
+            gtk_clipboard_set_text(clipboard, "", -1);
+        } else {
+            gtk_clipboard_set_text(clipboard, clip_clipboard_text_get_str(new), clip_clipboard_text_get_length(new));
+        }
         changed = TRUE;
     }
     g_free(old);
     return changed;
 }
 
-static char* clip_provider_prepare_value(ClipboardProvider *provider, char *text)
+static ClipboardText* clip_provider_prepare_value(ClipboardProvider *provider, ClipboardText *text)
 {
     if(provider->ownership_transferred){
         provider->ownership_transferred = FALSE;
         if(text == NULL){
             debug("Encountered a null after ownership transfer. Dropping and reverting current head.\n");
-            return g_strdup(provider->current);
+            return clip_clipboard_text_ref(provider->current);
         }
     }
-    return g_strdup(text);
+    return clip_clipboard_text_ref(text);
 }
 
 /**
- * Sets the provider clipboards to a copy of the specified value.
+ * Sets the provider clipboards to the specified value. The provider keeps its own reference to the value.
  */
-void clip_provider_set_current(ClipboardProvider *provider, char *text)
+void clip_provider_set_current(ClipboardProvider *provider, ClipboardText *text)
 {
-    char *copy = clip_provider_prepare_value(provider, text);
+    ClipboardText *copy = clip_provider_prepare_value(provider, text);
     if(!clip_provider_lock(provider)){
-        g_free(copy);
+        clip_clipboard_text_unref(copy);
         return;
     }
 
@@ -181,9 +377,9 @@ void clip_provider_set_current(ClipboardProvider *provider, char *text)
 #endif
     clip_provider_unlock(provider);
 
-    char *old = provider->current;
+    ClipboardText *old = provider->current;
     provider->current = copy;
-    g_free(old);
+    clip_clipboard_text_unref(old);
 }
 
 void clip_provider_clear(ClipboardProvider *provider)
@@ -203,6 +399,21 @@ void clip_provider_clear(ClipboardProvider *provider)
 
 
 
+/**
+ * Determines if a value from a settling owner has been unchanged long enough to capture. Until then, the value is held
+ * back and the current value is kept.
+ */
+static gboolean clip_provider_is_settled(ClipboardProvider *provider, const char *value)
+{
+    gint64 now = g_get_monotonic_time();
+    if(g_strcmp0(value, provider->settling)){
+        g_free(provider->settling);
+        provider->settling = g_strdup(value);
+        provider->settling_time = now;
+    }
+    return now - provider->settling_time >= SOURCE_SETTLE_INTERVAL * 1000;
+}
+
 /**
  * Syncs the two provider clipboards and sets the provider's current value to match that of the synced value.
  */
@@ -211,22 +422,67 @@ static void clip_provider_sync_clipboards(ClipboardProvider *provider)
     if(!clip_provider_lock(provider)){
         return;
     }
-    char *on_clipboard = gtk_clipboard_wait_for_text(provider->clipboard);
+    // An ignored owner's value is never read, so it can't be captured or synced over the other selection.
+    gboolean clipboard_ignored = provider->clipboard_source == SOURCE_IGNORE;
+    char *on_clipboard = clipboard_ignored ? NULL : gtk_clipboard_wait_for_text(provider->clipboard);
     char *selection = on_clipboard;
+    ClipSourcePolicy source = provider->clipboard_source;
 #if SYNC_CLIPBOARDS
-    char *on_primary = gtk_clipboard_wait_for_text(provider->selection);
+    char *on_primary = provider->selection_source == SOURCE_IGNORE
+        ? NULL
+        : gtk_clipboard_wait_for_text(provider->selection);
     // Check if the selection even has content.
     if(on_primary != NULL && strlen(on_primary) > 0){
         // Check if selection is different from clipboard. If it is, then make sure that it's the selection that changed and
         // not clipboard by comparing clipboard to "current".
-        if(g_strcmp0(on_primary, on_clipboard) && !g_strcmp0(on_clipboard, provider->current)){
+        if(g_strcmp0(on_primary, on_clipboard)
+            && (clipboard_ignored || !g_strcmp0(on_clipboard, provider->current))){
             // selection definitely changed. Use it.
             selection = on_primary;
+            source = provider->selection_source;
         }
     }
 #endif
     clip_provider_unlock(provider);
-    clip_provider_set_current(provider, selection);
+
+    if(selection == NULL && clipboard_ignored){
+        trace("Clipboard owner is ignored.\n");
+#if SYNC_CLIPBOARDS
+        g_free(on_primary);
+#endif
+        return;
+    }
+
+    gboolean changed = g_strcmp0(selection, clip_clipboard_text_get_str(provider->current)) != 0;
+    if(changed && source == SOURCE_SETTLE && !clip_provider_is_settled(provider, selection)){
+        trace("Clipboard value hasn't settled.\n");
+        g_free(on_clipboard);
+#if SYNC_CLIPBOARDS
+        g_free(on_primary);
+#endif
+        return;
+    }
+    if(changed){
+        provider->current_source = source;
+    }
+
+    // Adopt the selection rather than copying it. If it hasn't changed, keep sharing the current buffer.
+    ClipboardText *text = NULL;
+    if(selection != NULL && !changed){
+        text = clip_clipboard_text_ref(provider->current);
+    } else {
+        text = clip_clipboard_text_new_take(selection, -1);
+        if(selection == on_clipboard){
+            on_clipboard = NULL;
+        }
+#if SYNC_CLIPBOARDS
+        if(selection == on_primary){
+            on_primary = NULL;
+        }
+#endif
+    }
+    clip_provider_set_current(provider, text);
+    clip_clipboard_text_unref(text);
     g_free(on_clipboard);
 #if SYNC_CLIPBOARDS
     g_free(on_primary);
@@ -234,15 +490,20 @@ static void clip_provider_sync_clipboards(ClipboardProvider *provider)
 }
 
 /**
- * Returns a copy of the current system clipboard.
+ * Returns a new reference to the current system clipboard. This reference must be freed when no longer used.
  */
-char* clip_provider_get_current(ClipboardProvider *provider)
+ClipboardText* clip_provider_get_current(ClipboardProvider *provider)
 {
     clip_provider_sync_clipboards(provider);
-    return g_strdup(provider->current);
+    return clip_clipboard_text_ref(provider->current);
+}
+
+ClipSourcePolicy clip_provider_get_source(ClipboardProvider *provider)
+{
+    return provider->current_source;
 }
 
-void clip_provider_free_current(char *current)
+void clip_provider_free_current(ClipboardText *current)
 {
-    g_free(current);
+    clip_clipboard_text_unref(current);
 }
@@ -19,17 +19,31 @@
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include "clipboard_text.h"
+
 #include <glib.h>
 
+#ifndef __CLIP_PROVIDER_TYPES__
+#define __CLIP_PROVIDER_TYPES__
 typedef struct provider ClipboardProvider;
 
+/**
+ * How values from an application are captured, by the SOURCE_RULES.
+ */
+typedef enum {SOURCE_KEEP, SOURCE_SETTLE, SOURCE_TRANSIENT, SOURCE_IGNORE} ClipSourcePolicy;
+#endif
+
 ClipboardProvider* clip_provider_new(void);
 void clip_provider_free(ClipboardProvider *provider);
 
-char* clip_provider_get_current(ClipboardProvider *provider);
-void clip_provider_free_current(char *current);
+ClipboardText* clip_provider_get_current(ClipboardProvider *provider);
+/**
+ * Returns the policy of the application the current value came from.
+ */
+ClipSourcePolicy clip_provider_get_source(ClipboardProvider *provider);
+void clip_provider_free_current(ClipboardText *current);
 
 gboolean clip_provider_is_provider_ready(void);
-void clip_provider_set_current(ClipboardProvider *provider, char *text);
+void clip_provider_set_current(ClipboardProvider *provider, ClipboardText *text);
 void clip_provider_clear(ClipboardProvider *provider);
 
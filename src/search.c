@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "search.h"
+#include "config.h"
+#include "fuzzy.h"
+#include "utils.h"
+
+/**
+ * Everything the worker reads. The snapshot, pattern and fuzzy pattern are immutable, so they're shared with the main
+ * thread without locking. Batches on their way to the main thread keep a reference.
+ */
+typedef struct {
+    gint refs;
+    // The job's place in the order searches were started. Only the latest is run.
+    gint generation;
+    ClipboardHistorySnapshot *snapshot;
+    GRegex *pattern;
+    ClipFuzzyPattern *fuzzy_pattern;
+    GArray *candidates;
+    GArray *ids;
+    GCancellable *cancellable;
+    ClipSearchCallback callback;
+    gpointer user_data;
+} SearchJob;
+
+typedef struct {
+    SearchJob *job;
+    GArray *matches;
+    gboolean done;
+} SearchBatch;
+
+// The single worker searches run on, one at a time, started on first use.
+static GThreadPool *pool = NULL;
+static gint latest_generation = 0;
+
+
+static void clip_search_job_unref(SearchJob *job)
+{
+    if(!g_atomic_int_dec_and_test(&job->refs)){
+        return;
+    }
+    clip_history_snapshot_unref(job->snapshot);
+    if(job->pattern != NULL){
+        g_regex_unref(job->pattern);
+    }
+    clip_fuzzy_pattern_free(job->fuzzy_pattern);
+    if(job->candidates != NULL){
+        g_array_free(job->candidates, TRUE);
+    }
+    if(job->ids != NULL){
+        g_array_free(job->ids, TRUE);
+    }
+    g_object_unref(job->cancellable);
+    g_free(job);
+}
+
+/**
+ * Identifies if the job's results are no longer wanted: it's been cancelled, or another search has been started since.
+ */
+static gboolean clip_search_job_is_stale(SearchJob *job)
+{
+    return g_cancellable_is_cancelled(job->cancellable) || job->generation != g_atomic_int_get(&latest_generation);
+}
+
+static void clip_search_batch_free(SearchBatch *batch)
+{
+    g_array_free(batch->matches, TRUE);
+    clip_search_job_unref(batch->job);
+    g_free(batch);
+}
+
+static gboolean clip_search_cb_deliver(SearchBatch *batch)
+{
+    if(!clip_search_job_is_stale(batch->job)){
+        batch->job->callback(batch->matches, batch->done, batch->job->user_data);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * Hands a batch to the main thread. Batches are idle sources, so input and redraws are handled between them.
+ */
+static void clip_search_deliver(SearchJob *job, GArray *matches, gboolean done)
+{
+    SearchBatch *batch = g_malloc(sizeof(SearchBatch));
+    batch->job = job;
+    g_atomic_int_inc(&job->refs);
+    batch->matches = matches;
+    batch->done = done;
+    g_main_context_invoke_full(NULL, G_PRIORITY_DEFAULT_IDLE, (GSourceFunc)clip_search_cb_deliver, batch,
+            (GDestroyNotify)clip_search_batch_free);
+}
+
+/**
+ * Returns how much of the text a pattern is matched against. Some patterns take far longer than linear time, so only
+ * the start of a very long text is searched, cut at the start of a character so that it's still valid UTF-8.
+ */
+static gsize clip_search_get_pattern_length(const char *text, gsize length)
+{
+    if(length <= SEARCH_PATTERN_TEXT_LIMIT){
+        return length;
+    }
+    length = SEARCH_PATTERN_TEXT_LIMIT;
+    while(length > 0 && (text[length] & 0xc0) == 0x80){
+        length--;
+    }
+    return length;
+}
+
+static void clip_search_thread(SearchJob *job, gpointer user_data)
+{
+    // Jobs queued behind a newer search are dropped without being run.
+    if(clip_search_job_is_stale(job)){
+        clip_search_job_unref(job);
+        return;
+    }
+
+    guint rows = clip_history_snapshot_get_length(job->snapshot);
+    guint length = job->candidates != NULL ? job->candidates->len : rows;
+    GArray *matches = g_array_new(FALSE, FALSE, sizeof(ClipSearchMatch));
+    gboolean delivered = FALSE;
+
+    // The set's keys point into the ids array, which outlives it.
+    GHashTable *ids = NULL;
+    if(job->ids != NULL){
+        ids = g_hash_table_new(g_int64_hash, g_int64_equal);
+        for(guint i = 0; i < job->ids->len; i++){
+            g_hash_table_add(ids, &g_array_index(job->ids, int64_t, i));
+        }
+    }
+    gint64 delivered_time = g_get_monotonic_time();
+
+    for(guint i = 0; i < length; i++){
+        // A pathological pattern can only hold up this thread, and only until the current row is done.
+        if(clip_search_job_is_stale(job)){
+            g_array_free(matches, TRUE);
+            goto exit;
+        }
+
+        ClipSearchMatch match = { job->candidates != NULL ? g_array_index(job->candidates, int, i) : (int)i, 0 };
+        if(match.row < 0 || match.row >= (int)rows){
+            continue;
+        } else if(ids != NULL){
+            int64_t id = clip_history_snapshot_get_id(job->snapshot, match.row);
+            if(!g_hash_table_contains(ids, &id)){
+                continue;
+            }
+        }
+        const char *text = clip_history_snapshot_get_text(job->snapshot, match.row);
+        gsize text_length = clip_history_snapshot_get_text_length(job->snapshot, match.row);
+        gboolean matched = job->pattern != NULL
+            ? g_regex_match_full(job->pattern, text, clip_search_get_pattern_length(text, text_length), 0, 0, NULL, NULL)
+            : clip_fuzzy_match(job->fuzzy_pattern, text, text_length, &match.score);
+        if(matched){
+            g_array_append_val(matches, match);
+        }
+
+        if(matches->len > 0 && (!delivered || g_get_monotonic_time() - delivered_time >= SEARCH_BATCH_INTERVAL)){
+            clip_search_deliver(job, matches, FALSE);
+            matches = g_array_new(FALSE, FALSE, sizeof(ClipSearchMatch));
+            delivered = TRUE;
+            delivered_time = g_get_monotonic_time();
+        }
+    }
+    clip_search_deliver(job, matches, TRUE);
+
+exit:
+    if(ids != NULL){
+        g_hash_table_destroy(ids);
+    }
+    clip_search_job_unref(job);
+}
+
+GCancellable* clip_search_start(ClipboardHistorySnapshot *snapshot, GRegex *pattern, const char *term,
+        GArray *candidates, GArray *ids, ClipSearchCallback callback, gpointer user_data)
+{
+    if(pool == NULL){
+        pool = g_thread_pool_new((GFunc)clip_search_thread, NULL, 1, FALSE, NULL);
+    }
+
+    SearchJob *job = g_malloc(sizeof(SearchJob));
+    job->refs = 1;
+    job->generation = g_atomic_int_add(&latest_generation, 1) + 1;
+    job->snapshot = clip_history_snapshot_ref(snapshot);
+    job->pattern = pattern == NULL ? NULL : g_regex_ref(pattern);
+    job->fuzzy_pattern = pattern == NULL ? clip_fuzzy_pattern_new(term) : NULL;
+    job->candidates = candidates;
+    job->ids = ids;
+    job->cancellable = g_cancellable_new();
+    job->callback = callback;
+    job->user_data = user_data;
+
+    trace("Searching %u rows for '%s'.\n",
+            ids != NULL ? ids->len : candidates != NULL ? candidates->len : clip_history_snapshot_get_length(snapshot), term);
+    g_thread_pool_push(pool, job, NULL);
+    return g_object_ref(job->cancellable);
+}
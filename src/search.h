@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "history_snapshot.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+
+#ifndef __CLIP_SEARCH_TYPES__
+#define __CLIP_SEARCH_TYPES__
+typedef struct {
+    int row;
+    gint score;
+} ClipSearchMatch;
+
+/**
+ * Receives a batch of ClipSearchMatch on the main thread. The last batch has done set. Nothing is delivered once the
+ * search is cancelled.
+ */
+typedef void (*ClipSearchCallback)(GArray *matches, gboolean done, gpointer user_data);
+#endif
+
+/**
+ * Searches the snapshot's rows on a dedicated worker thread, matching either the pattern or, if pattern is NULL, the fuzzy term.
+ * If candidates isn't NULL, only those rows are tested, in that order. If ids isn't NULL, only rows with those ids are
+ * tested. The search takes ownership of both arrays.
+ * <br />
+ * Searches run one at a time. Starting a search supersedes any still running or waiting, which stop without delivering
+ * anything more. Regex patterns are only matched against the first SEARCH_PATTERN_TEXT_LIMIT bytes of each row.
+ * <br />
+ * Matches are delivered in batches as they're found, the first as soon as there is one. Returns a cancellable which
+ * stops the search, owned by the caller.
+ */
+GCancellable* clip_search_start(ClipboardHistorySnapshot *snapshot, GRegex *pattern, const char *term,
+        GArray *candidates, GArray *ids, ClipSearchCallback callback, gpointer user_data);
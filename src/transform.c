@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "transform.h"
+#include "ascii.h"
+#include "utils.h"
+
+#include <string.h>
+
+typedef struct {
+    ClipTransform transform;
+    ClipboardText *text;
+    ClipboardText *other;
+    ClipTransformCallback callback;
+    gpointer user_data;
+} TransformJob;
+
+
+static void clip_transform_job_free(TransformJob *job)
+{
+    clip_clipboard_text_unref(job->text);
+    clip_clipboard_text_unref(job->other);
+    g_free(job);
+}
+
+/**
+ * Determines if the locale maps ASCII letters' case the same as ASCII does. It doesn't in Turkish, where i maps to a
+ * dotted capital I.
+ */
+static gboolean clip_transform_has_ascii_case(void)
+{
+    static gsize checked = 0;
+    static gboolean ascii_case = FALSE;
+    if(g_once_init_enter(&checked)){
+        char *upper = g_utf8_strup("i", -1);
+        char *lower = g_utf8_strdown("I", -1);
+        ascii_case = strcmp(upper, "I") == 0 && strcmp(lower, "i") == 0;
+        g_free(upper);
+        g_free(lower);
+        g_once_init_leave(&checked, 1);
+    }
+    return ascii_case;
+}
+
+/**
+ * Changes the text's case. ASCII text, which most large entries are, is mapped without decoding it.
+ */
+static ClipboardText* clip_transform_change_case(const char *text, gsize length, gboolean upper)
+{
+    if(!clip_transform_has_ascii_case() || clip_ascii_span(text, length) < length){
+        return clip_clipboard_text_new_take(upper ? g_utf8_strup(text, length) : g_utf8_strdown(text, length), -1);
+    }
+    char *changed = g_malloc(length + 1);
+    clip_ascii_map_case(changed, text, length, upper);
+    changed[length] = '\0';
+    return clip_clipboard_text_new_take(changed, length);
+}
+
+static ClipboardText* clip_transform_join(ClipboardText *left, ClipboardText *right)
+{
+    gsize left_length = clip_clipboard_text_get_length(left);
+    gsize right_length = clip_clipboard_text_get_length(right);
+    char *joined = g_malloc(left_length + right_length + 2);
+    memcpy(joined, clip_clipboard_text_get_str(left), left_length);
+    joined[left_length] = ' ';
+    memcpy(joined + left_length + 1, clip_clipboard_text_get_str(right), right_length);
+    joined[left_length + right_length + 1] = '\0';
+    return clip_clipboard_text_new_take(joined, left_length + right_length + 1);
+}
+
+static void clip_transform_thread(GTask *task, gpointer source, TransformJob *job, GCancellable *cancellable)
+{
+    // A transform superseded while it was queued isn't worth starting.
+    if(g_cancellable_is_cancelled(cancellable)){
+        g_task_return_pointer(task, NULL, NULL);
+        return;
+    }
+
+    const char *text = clip_clipboard_text_get_str(job->text);
+    gsize length = clip_clipboard_text_get_length(job->text);
+    ClipboardText *transformed = NULL;
+    switch(job->transform){
+        case TRANSFORM_TRIM:
+            transformed = clip_clipboard_text_trim(job->text, TRUE, TRUE);
+            break;
+        case TRANSFORM_UPPER:
+            transformed = clip_transform_change_case(text, length, TRUE);
+            break;
+        case TRANSFORM_LOWER:
+            transformed = clip_transform_change_case(text, length, FALSE);
+            break;
+        case TRANSFORM_JOIN:
+            transformed = clip_transform_join(job->text, job->other);
+            break;
+    }
+    g_task_return_pointer(task, transformed, (GDestroyNotify)clip_clipboard_text_unref);
+}
+
+/**
+ * Delivers the result. A cancelled task returns an error rather than its text, even if the worker finished.
+ */
+static void clip_transform_cb_done(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    TransformJob *job = g_task_get_task_data(G_TASK(result));
+    ClipboardText *transformed = g_task_propagate_pointer(G_TASK(result), NULL);
+    job->callback(transformed, job->user_data);
+    clip_clipboard_text_unref(transformed);
+}
+
+GCancellable* clip_transform_start(ClipTransform transform, ClipboardText *text, ClipboardText *other,
+        ClipTransformCallback callback, gpointer user_data)
+{
+    TransformJob *job = g_malloc(sizeof(TransformJob));
+    job->transform = transform;
+    job->text = clip_clipboard_text_ref(text);
+    job->other = clip_clipboard_text_ref(other);
+    job->callback = callback;
+    job->user_data = user_data;
+
+    trace("Transforming %"G_GSIZE_FORMAT" bytes.\n", clip_clipboard_text_get_length(text));
+    GCancellable *cancellable = g_cancellable_new();
+    GTask *task = g_task_new(NULL, cancellable, clip_transform_cb_done, NULL);
+    g_task_set_task_data(task, job, (GDestroyNotify)clip_transform_job_free);
+    g_task_run_in_thread(task, (GTaskThreadFunc)clip_transform_thread);
+    g_object_unref(task);
+    return cancellable;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2016 Richard Burnison
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "clipboard_text.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+
+#ifndef __CLIP_TRANSFORM_TYPES__
+#define __CLIP_TRANSFORM_TYPES__
+typedef enum {TRANSFORM_TRIM, TRANSFORM_UPPER, TRANSFORM_LOWER, TRANSFORM_JOIN} ClipTransform;
+
+/**
+ * Receives the transformed text on the main thread. The text is NULL if the transform was cancelled. The callback must
+ * take its own reference to keep it.
+ */
+typedef void (*ClipTransformCallback)(ClipboardText *transformed, gpointer user_data);
+#endif
+
+/**
+ * Transforms the text on a worker thread. A join appends other to text, separated by a space; the other transforms
+ * ignore it. Texts are immutable, so they're shared with the worker without copying.
+ * <br />
+ * The callback is always called exactly once. Returns a cancellable which abandons the transform, owned by the caller.
+ */
+GCancellable* clip_transform_start(ClipTransform transform, ClipboardText *text, ClipboardText *other,
+        ClipTransformCallback callback, gpointer user_data);